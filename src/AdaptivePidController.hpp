@@ -0,0 +1,60 @@
+#ifndef __ADAPTIVE_PID_CONTROLLER_H
+#define __ADAPTIVE_PID_CONTROLLER_H
+
+#include <math.h>
+#include "PidController.hpp"
+
+// PID controller that keeps adjusting its own gains while it runs, with the
+// MIT rule: every gain follows the negative gradient of the squared error,
+// where the sensitivity of the error to a gain is approximated by the signal
+// that gain multiplies (the error, its integral, or its rate). The update is
+// normalized by the size of those signals so that a large error can't throw
+// the gains off, and sigma-modification pulls them back towards the nominal
+// gains, so they don't drift when the error is small. The gains are kept
+// within [lower, upper] at all times. Every step costs O(1).
+class AdaptivePidController {
+  Gains gains;
+  Gains nominal;
+  Gains lower;
+  Gains upper;
+  Gains rates;
+  double sigma;
+  double set_point;
+  double error_i;
+  double prev_error;
+  bool started;
+
+public:
+  AdaptivePidController(const Gains& nominal, const Gains& lower, const Gains& upper, const Gains& rates,
+			double sigma, double set_point):
+    gains(nominal), nominal(nominal), lower(lower), upper(upper), rates(rates),
+    sigma(sigma), set_point(set_point),
+    error_i(0), prev_error(0), started(false) {}
+
+  double operator()(double measured_value, double delta_t) {
+    double error = set_point - measured_value;
+    double error_d = started && delta_t != 0 ? (error - prev_error) / delta_t : 0;
+    // The derivative gain is driven by the midpoint error, which makes its
+    // update the rate of change of the squared error. Sensor noise would
+    // otherwise bias it upwards, as the product of the current error and
+    // its difference has a positive mean.
+    double midpoint = started ? (error + prev_error) / 2 : error;
+    error_i += error * delta_t;
+    prev_error = error;
+    started = true;
+
+    double output = gains.p * error + gains.i * error_i + gains.d * error_d;
+
+    double signals[3] = { error * error, error * error_i, midpoint * error_d };
+    double norm = 1 + error * error + error_i * error_i + error_d * error_d;
+    for (int k = 0; k < 3; k++) {
+      double change = rates[k] * signals[k] / norm - sigma * (gains[k] - nominal[k]);
+      gains[k] = fmin(upper[k], fmax(lower[k], gains[k] + change * delta_t));
+    }
+    return output;
+  }
+
+  const Gains& currentGains() const { return gains; }
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "AsyncTwiddler.hpp"
+
+void AsyncTwiddleStep::advance() {
+  if (direction > 0) {
+    direction = -1;
+    return;
+  }
+  direction = 1;
+  do {
+    current_gain = (current_gain + 1) % 3;
+  } while (increments[current_gain] == 0);
+}
+
+void AsyncTwiddleStep::improve(const Ticket& ticket, double error) {
+  best_error = error;
+  best_result = ticket.gains;
+  generation++;
+}
+
+AsyncTwiddleStep::AsyncTwiddleStep(const Gains& init, const Gains& increments):
+  best_result(init), best_error(-1),
+  increments(increments), generation(0),
+  current_gain(0), direction(1), baseline_issued(false),
+  reported(0), stale(0) {
+  for (int k = 0; k < 3; k++) {
+    failed[k][0] = failed[k][1] = -1;
+  }
+  while (this->increments[current_gain] == 0 && current_gain < 2) {
+    current_gain++;
+  }
+}
+
+AsyncTwiddleStep::Ticket AsyncTwiddleStep::propose() {
+  Ticket ticket = { best_result, generation, -1, 0 };
+  if (!baseline_issued) {
+    baseline_issued = true;
+    return ticket;
+  }
+  while (!requeued.empty()) {
+    Ticket again = requeued.front();
+    requeued.pop_front();
+    if (!isStale(again)) {
+      return again;
+    }
+  }
+
+  ticket.gain = current_gain;
+  ticket.direction = direction;
+  ticket.gains[current_gain] += direction * increments[current_gain];
+  advance();
+  return ticket;
+}
+
+void AsyncTwiddleStep::report(const Ticket& ticket, double error) {
+  reported++;
+  if (best_error >= 0) {
+    judge(ticket, error);
+    return;
+  }
+  if (ticket.gain >= 0) {
+    early.push_back(std::make_pair(ticket, error));
+    return;
+  }
+
+  // The baseline leaves the best gains as they are, so the probes proposed
+  // around them stay fresh.
+  best_error = error;
+  for (const auto& result: early) {
+    judge(result.first, result.second);
+  }
+  early.clear();
+}
+
+void AsyncTwiddleStep::cancel(const Ticket& ticket) {
+  if (ticket.gain < 0) {
+    baseline_issued = best_error >= 0;
+  } else {
+    requeued.push_back(ticket);
+  }
+}
+
+void AsyncTwiddleStep::judge(const Ticket& ticket, double error) {
+  bool fresh = !isStale(ticket);
+  if (!fresh) {
+    stale++;
+  }
+
+  if (error < best_error) {
+    if (fresh && ticket.gain >= 0) {
+      increments[ticket.gain] *= 1.1;
+    }
+    improve(ticket, error);
+    return;
+  }
+
+  if (!fresh || ticket.gain < 0) {
+    return;
+  }
+  failed[ticket.gain][ticket.direction > 0 ? 0 : 1] = generation;
+  if (failed[ticket.gain][0] == generation && failed[ticket.gain][1] == generation) {
+    increments[ticket.gain] *= 0.9;
+    failed[ticket.gain][0] = failed[ticket.gain][1] = -1;
+  }
+}
+
+AsyncTwiddler::Episode& AsyncTwiddler::episodeFor(int session) {
+  auto found = episodes.find(session);
+  if (found != episodes.end()) {
+    return found->second;
+  }
+
+  AsyncTwiddleStep::Ticket ticket = twiddle_step.propose();
+  Episode episode = {
+    ticket,
+    PidController(ticket.gains, 0),
+    PidController(Gains(0.8, 0, 0), speed),
+    EpisodeCost(cost_weights)
+  };
+  const Gains& gains = ticket.gains;
+  std::cout << "Session " << session << " trying: [" << gains.p << ", " << gains.i << ", " << gains.d << "]" << std::endl;
+  return episodes.insert(std::make_pair(session, episode)).first->second;
+}
+
+void AsyncTwiddler::finishEpisode(SimulatorResponder& responder, int session, Episode& episode, double error) {
+  const AsyncTwiddleStep::Ticket& ticket = episode.ticket;
+  const Gains& gains = ticket.gains;
+  std::cout << "Session " << session << " result: [" << gains.p << ", " << gains.i << ", " << gains.d << "]"
+	    << " error " << error << (twiddle_step.isStale(ticket) ? " (stale)" : "") << std::endl;
+
+  twiddle_step.report(ticket, error);
+  episodes.erase(session);
+  reportBest();
+
+  if (twiddle_step.hasFinished()) {
+    responder.stop();
+    return;
+  }
+  responder.reset();
+}
+
+void AsyncTwiddler::sessionClosed(int session) {
+  auto found = episodes.find(session);
+  if (found == episodes.end()) {
+    return;
+  }
+  const Gains& gains = found->second.ticket.gains;
+  std::cout << "Session " << session << " closed, requeueing: [" << gains.p << ", " << gains.i << ", " << gains.d << "]" << std::endl;
+  twiddle_step.cancel(found->second.ticket);
+  episodes.erase(found);
+}
+
+void AsyncTwiddler::reportBest() const {
+  const Gains& best = twiddle_step.bestResult();
+  const Gains& increment = twiddle_step.incr();
+  std::cout << "Best result: [" << best.p << ", " << best.i << ", " << best.d << "]"
+	    << " error " << twiddle_step.bestError() << std::endl;
+  std::cout << "Increment: [" << increment.p << ", " << increment.i << ", " << increment.d << "]" << std::endl;
+  std::cout << "Results: " << twiddle_step.reportedResults() << ", stale: " << twiddle_step.staleResults() << std::endl << std::endl;
+}
+
+void AsyncTwiddler::operator()(SimulatorResponder& responder, const Measurement& m) {
+  Episode& episode = episodeFor(m.session);
+  if (m.step < max_steps) {
+    if (fabs(m.cte) > max_cte) {
+      finishEpisode(responder, m.session, episode, episode.cost.value(m.step) + 1e6 / m.step);
+    } else {
+      double steer_angle = episode.steer_controller(m.cte, m.delta_t);
+      double throttle = episode.throttle_controller(m.speed, m.delta_t);
+      episode.cost(m.cte, steer_angle, m.speed, m.delta_t);
+      responder.control(steer_angle, throttle);
+    }
+  } else {
+    finishEpisode(responder, m.session, episode, episode.cost.value(m.step));
+  }
+}
@@ -0,0 +1,111 @@
+#ifndef __ASYNC_TWIDDLER_H
+#define __ASYNC_TWIDDLER_H
+
+#include <deque>
+#include <iostream>
+#include <map>
+#include <vector>
+#include "EpisodeCost.hpp"
+#include "PidController.hpp"
+#include "Responder.hpp"
+
+// Asynchronous variant of TwiddleStep that keeps several candidates in
+// flight at once. Each proposal probes one gain at +increment or -increment
+// around the best gains known at the time, and results are folded in as
+// they arrive, in any order.
+//
+// A result is stale when the best gains have changed since its candidate
+// was proposed. As in asynchronous hyperparameter search, a stale result
+// still counts if it beats the best error, since it is a valid evaluation
+// of its own gains, but it is otherwise discarded: a failure measured
+// around an outdated point says nothing about the increments around the
+// new one.
+//
+// Probes that finish before the baseline are held until it is recorded,
+// since there is nothing to compare them with, and a ticket whose episode
+// is cancelled is proposed again.
+class AsyncTwiddleStep {
+public:
+  struct Ticket {
+    Gains gains;
+    int generation;
+    int gain;
+    int direction;
+  };
+
+private:
+  Gains best_result;
+  double best_error;
+  Gains increments;
+  int generation;
+
+  int current_gain;
+  int direction;
+  bool baseline_issued;
+  int failed[3][2];
+  int reported;
+  int stale;
+  std::deque<Ticket> requeued;
+  std::vector<std::pair<Ticket, double>> early;
+
+  void advance();
+  void improve(const Ticket& ticket, double error);
+  void judge(const Ticket& ticket, double error);
+
+public:
+  AsyncTwiddleStep(const Gains& init, const Gains& increments);
+
+  const Gains& bestResult() const { return best_result; }
+  const Gains& incr() const { return increments; }
+  double bestError() const { return best_error; }
+  bool hasFinished() const { return (increments.p + increments.i + increments.d) < 0.01; }
+  int epoch() const { return generation; }
+  int reportedResults() const { return reported; }
+  int staleResults() const { return stale; }
+  bool isStale(const Ticket& ticket) const { return ticket.generation != generation; }
+
+  Ticket propose();
+  void report(const Ticket& ticket, double error);
+  // Gives back a ticket that will never be reported, such as the one of a
+  // simulator that disconnected.
+  void cancel(const Ticket& ticket);
+};
+
+// Runs AsyncTwiddleStep against a pool of simulator connections: every
+// session evaluates its own candidate, and gets a new one as soon as its
+// episode is over.
+class AsyncTwiddler {
+  struct Episode {
+    AsyncTwiddleStep::Ticket ticket;
+    PidController steer_controller;
+    PidController throttle_controller;
+    EpisodeCost cost;
+  };
+
+  AsyncTwiddleStep twiddle_step;
+  std::map<int, Episode> episodes;
+  CostWeights cost_weights;
+  int max_steps;
+  double max_cte;
+  double speed;
+
+  Episode& episodeFor(int session);
+  void finishEpisode(SimulatorResponder& responder, int session, Episode& episode, double error);
+  void reportBest() const;
+
+public:
+  AsyncTwiddler(int max_steps, double max_cte, double speed, const Gains& init_gains, const Gains& increment,
+		const CostWeights& cost_weights = CostWeights()):
+    twiddle_step(init_gains, increment),
+    cost_weights(cost_weights),
+    max_steps(max_steps),
+    max_cte(max_cte),
+    speed(speed) {}
+
+  void operator()(SimulatorResponder& responder, const Measurement& m);
+  // Drops the episode of a session that went away and requeues its
+  // candidate.
+  void sessionClosed(int session);
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "BayesianOptimizer.hpp"
+
+double GaussianProcess::kernel(const Point& a, const Point& b) const {
+  double r2 = 0;
+  for (int k = 0; k < 3; k++) {
+    double delta = a.x[k] - b.x[k];
+    r2 += delta * delta;
+  }
+  double r = sqrt(5 * r2) / length_scale;
+  return (1 + r + r * r / 3) * exp(-r);
+}
+
+void GaussianProcess::forward(std::vector<double>& b) const {
+  for (size_t i = 0; i < b.size(); i++) {
+    double sum = b[i];
+    for (size_t j = 0; j < i; j++) {
+      sum -= cholAt(i, j) * b[j];
+    }
+    b[i] = sum / cholAt(i, i);
+  }
+}
+
+void GaussianProcess::backward(std::vector<double>& b) const {
+  for (size_t i = b.size(); i-- > 0;) {
+    double sum = b[i];
+    for (size_t j = i + 1; j < b.size(); j++) {
+      sum -= cholAt(j, i) * b[j];
+    }
+    b[i] = sum / cholAt(i, i);
+  }
+}
+
+void GaussianProcess::updateAlpha() {
+  mean = 0;
+  for (double value: values) mean += value;
+  mean /= values.size();
+
+  double variance = 0;
+  for (double value: values) variance += (value - mean) * (value - mean);
+  scale = values.size() > 1 ? sqrt(variance / (values.size() - 1)) : 1;
+  if (scale <= 0) scale = 1;
+
+  alpha.resize(values.size());
+  for (size_t i = 0; i < values.size(); i++) {
+    alpha[i] = (values[i] - mean) / scale;
+  }
+  forward(alpha);
+  backward(alpha);
+}
+
+void GaussianProcess::add(const double x[3], double value) {
+  Point p = { { x[0], x[1], x[2] } };
+  std::vector<double> row(points.size());
+  for (size_t i = 0; i < points.size(); i++) {
+    row[i] = kernel(points[i], p);
+  }
+  forward(row);
+
+  double diagonal = kernel(p, p) + noise;
+  for (double r: row) diagonal -= r * r;
+
+  chol.insert(chol.end(), row.begin(), row.end());
+  chol.push_back(sqrt(fmax(diagonal, 1e-12)));
+  points.push_back(p);
+  values.push_back(value);
+  updateAlpha();
+}
+
+void GaussianProcess::predict(const double x[3], double& mu, double& sigma, std::vector<double>& work) const {
+  Point p = { { x[0], x[1], x[2] } };
+  work.resize(points.size());
+  double m = 0;
+  for (size_t i = 0; i < points.size(); i++) {
+    work[i] = kernel(points[i], p);
+    m += work[i] * alpha[i];
+  }
+  forward(work);
+  double variance = kernel(p, p);
+  for (double w: work) variance -= w * w;
+
+  mu = mean + scale * m;
+  sigma = scale * sqrt(fmax(variance, 0.0));
+}
+
+void BayesianStep::normalize(const Gains& g, double x[3]) const {
+  const double values[3] = { g.p, g.i, g.d };
+  const double lo[3] = { lower.p, lower.i, lower.d };
+  const double hi[3] = { upper.p, upper.i, upper.d };
+  for (int k = 0; k < 3; k++) {
+    x[k] = (values[k] - lo[k]) / (hi[k] - lo[k]);
+  }
+}
+
+Gains BayesianStep::denormalize(const double x[3]) const {
+  return Gains(lower.p + x[0] * (upper.p - lower.p),
+	       lower.i + x[1] * (upper.i - lower.i),
+	       lower.d + x[2] * (upper.d - lower.d));
+}
+
+double BayesianStep::expectedImprovement(double best, double mu, double sigma) {
+  if (sigma <= 0) {
+    return 0;
+  }
+  double improvement = best - mu;
+  double z = improvement / sigma;
+  double cdf = 0.5 * erfc(-z / sqrt(2.0));
+  double pdf = exp(-0.5 * z * z) / sqrt(2 * M_PI);
+  return improvement * cdf + sigma * pdf;
+}
+
+bool BayesianStep::nearRejected(const double x[3]) const {
+  for (size_t i = 0; i < rejected.size(); i += 3) {
+    double r2 = 0;
+    for (int k = 0; k < 3; k++) {
+      double delta = x[k] - rejected[i + k];
+      r2 += delta * delta;
+    }
+    if (r2 < REJECTED_RADIUS * REJECTED_RADIUS) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Gains BayesianStep::propose() {
+  std::uniform_real_distribution<double> uniform(0, 1);
+  double x[3];
+  if (evaluations < INITIAL_SAMPLES) {
+    for (int k = 0; k < 3; k++) x[k] = uniform(random);
+    return denormalize(x);
+  }
+
+  // Half of the candidates are spread over the whole box, the other half
+  // perturb the best result found so far.
+  std::normal_distribution<double> local(0, 0.05);
+  double best_x[3];
+  normalize(best_result, best_x);
+  double log_best = log(best_error);
+
+  double chosen[3] = { best_x[0], best_x[1], best_x[2] };
+  double chosen_ei = -1;
+  std::vector<double> work;
+  for (int c = 0; c < CANDIDATES; c++) {
+    for (int k = 0; k < 3; k++) {
+      x[k] = (c % 2 == 0) ? uniform(random) : fmin(1.0, fmax(0.0, best_x[k] + local(random)));
+    }
+    if (nearRejected(x)) {
+      continue;
+    }
+    double mu, sigma;
+    process.predict(x, mu, sigma, work);
+    double ei = expectedImprovement(log_best, mu, sigma);
+    if (ei > chosen_ei) {
+      chosen_ei = ei;
+      for (int k = 0; k < 3; k++) chosen[k] = x[k];
+    }
+  }
+  return denormalize(chosen);
+}
+
+void BayesianStep::next(double error) {
+  double x[3];
+  normalize(gains, x);
+  process.add(x, log(fmax(error, 1e-12)));
+  evaluations++;
+
+  if (best_error < 0 || error < best_error) {
+    best_error = error;
+    best_result = gains;
+  }
+  gains = propose();
+}
+
+void BayesianStep::reject() {
+  double x[3];
+  normalize(gains, x);
+  rejected.insert(rejected.end(), x, x + 3);
+  rejections++;
+  gains = propose();
+}
+
+void reportSearchState(const BayesianStep& step) {
+  const Gains& lo = step.lowerBound();
+  const Gains& hi = step.upperBound();
+  std::cout << "Search box: [" << lo.p << ", " << lo.i << ", " << lo.d << "] - ["
+	    << hi.p << ", " << hi.i << ", " << hi.d << "]" << std::endl;
+}
@@ -0,0 +1,100 @@
+#ifndef __BAYESIAN_OPTIMIZER_H
+#define __BAYESIAN_OPTIMIZER_H
+
+#include <iostream>
+#include <math.h>
+#include <random>
+#include <vector>
+#include "PidController.hpp"
+
+// Gaussian process regression over the gains, normalized to the unit cube.
+// The Cholesky factor of the kernel matrix is kept in packed lower
+// triangular form and grows by one row per observation, so adding a point
+// costs O(n^2) instead of refactoring the whole matrix.
+class GaussianProcess {
+  struct Point { double x[3]; };
+
+  std::vector<Point> points;
+  std::vector<double> values;
+  std::vector<double> chol;
+  std::vector<double> alpha;
+  double length_scale;
+  double noise;
+  double mean;
+  double scale;
+
+  double kernel(const Point& a, const Point& b) const;
+
+  double cholAt(size_t row, size_t col) const { return chol[row * (row + 1) / 2 + col]; }
+
+  // Solves L y = b in place.
+  void forward(std::vector<double>& b) const;
+
+  // Solves L^T y = b in place.
+  void backward(std::vector<double>& b) const;
+  void updateAlpha();
+
+public:
+  GaussianProcess(double length_scale = 0.2, double noise = 1e-4):
+    length_scale(length_scale), noise(noise), mean(0), scale(1) {}
+
+  size_t size() const { return points.size(); }
+
+  void add(const double x[3], double value);
+  void predict(const double x[3], double& mu, double& sigma, std::vector<double>& work) const;
+};
+
+// Bayesian optimization of the gains: an alternative to TwiddleStep with the
+// same interface, meant for tuning against the real simulator, where every
+// episode is expensive. The GP models the log of the episode error, and the
+// next candidate maximizes the expected improvement over the best error so
+// far. Rejected candidates have no error and stay out of the GP; the search
+// avoids their neighbourhood instead, and they count against the budget, so
+// a region that keeps being rejected can't stall it.
+class BayesianStep {
+  Gains lower;
+  Gains upper;
+  Gains gains;
+  Gains best_result;
+  double best_error;
+  int max_evaluations;
+  int evaluations;
+  int rejections;
+  // Normalized rejected candidates, three coordinates each.
+  std::vector<double> rejected;
+  GaussianProcess process;
+  std::mt19937 random;
+
+  static const int INITIAL_SAMPLES = 5;
+  static const int CANDIDATES = 3000;
+  static constexpr double REJECTED_RADIUS = 0.05;
+
+  void normalize(const Gains& g, double x[3]) const;
+  Gains denormalize(const double x[3]) const;
+  static double expectedImprovement(double best, double mu, double sigma);
+  bool nearRejected(const double x[3]) const;
+  Gains propose();
+
+public:
+  BayesianStep(const Gains& init, const Gains& lower, const Gains& upper, int max_evaluations, unsigned seed = 1):
+    lower(lower), upper(upper),
+    gains(init), best_result(init), best_error(-1),
+    max_evaluations(max_evaluations), evaluations(0), rejections(0),
+    random(seed) {}
+
+  const Gains& current() const { return gains; }
+  const Gains& bestResult() const { return best_result; }
+  const Gains& lowerBound() const { return lower; }
+  const Gains& upperBound() const { return upper; }
+
+  bool hasFinished() const { return evaluations + rejections >= max_evaluations; }
+  double bestError() const { return best_error; }
+  int epoch() const { return evaluations; }
+
+  void next(double error);
+  void reject();
+};
+
+void reportSearchState(const BayesianStep& step);
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef __CONTROLLER_GRAPH_H
+#define __CONTROLLER_GRAPH_H
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <tuple>
+#include "PidController.hpp"
+
+// Nodes of a ControllerGraph. A node reads and writes signals, which are
+// slots of an array of doubles named by their index, and the slots are
+// template parameters, so every access is to a fixed offset. Each node is
+// called as node(signals, delta_t), and gives the number of slots it uses
+// in SLOTS. Nodes are written without conditional jumps: a division by a
+// delta_t that may be 0 is a multiplication by inverseOrZero(delta_t), and
+// limits are min and max.
+
+// 1 / x, to the last bit or so, or 0 when x is 0. Without a comparison,
+// which compilers turn into a jump; x * x must not underflow, which holds
+// for any delta_t above 1e-150 s.
+inline double inverseOrZero(double x) {
+  return x / (x * x + DBL_MIN);
+}
+
+// A PID on ref - in, where ref is a slot, or 0 when Ref is -1. It steps as
+// PidController does.
+template <int Out, int In, int Ref = -1>
+class Pid {
+  Gains gains;
+  double error_i;
+  double prev_error;
+
+public:
+  static constexpr int SLOTS = std::max({ Out, In, Ref }) + 1;
+
+  Pid(const Gains& gains): gains(gains), error_i(0), prev_error(0) {}
+
+  void operator()(double* signals, double delta_t) {
+    double error = -signals[In];
+    if constexpr (Ref >= 0) {
+      error += signals[Ref];
+    }
+    double error_d = (error - prev_error) * inverseOrZero(delta_t);
+    error_i += error * delta_t;
+    prev_error = error;
+    signals[Out] = gains.p * error + gains.i * error_i + gains.d * error_d;
+  }
+};
+
+// Rate of change of a signal per second, low-passed with a time constant,
+// which must be positive. It starts from 0 at the first frame.
+template <int Out, int In>
+class Rate {
+  double smoothing;
+  double previous;
+  double rate;
+  double started;
+
+public:
+  static constexpr int SLOTS = std::max(Out, In) + 1;
+
+  Rate(double smoothing = 0.1): smoothing(smoothing), previous(0), rate(0), started(0) {}
+
+  void operator()(double* signals, double delta_t) {
+    double raw = (signals[In] - previous) * inverseOrZero(delta_t);
+    rate += (raw - rate) * started * delta_t / (smoothing + delta_t);
+    previous = signals[In];
+    started = 1;
+    signals[Out] = rate;
+  }
+};
+
+// out += gain * in, to add a feedforward term to the output of a loop.
+template <int Out, int In>
+struct Feedforward {
+  static constexpr int SLOTS = std::max(Out, In) + 1;
+
+  double gain;
+
+  Feedforward(double gain): gain(gain) {}
+
+  void operator()(double* signals, double) const {
+    signals[Out] += gain * signals[In];
+  }
+};
+
+// Limits a signal to [low, high].
+template <int Out, int In>
+struct Limit {
+  static constexpr int SLOTS = std::max(Out, In) + 1;
+
+  double low;
+  double high;
+
+  Limit(double low = -1, double high = 1): low(low), high(high) {}
+
+  void operator()(double* signals, double) const {
+    signals[Out] = std::min(std::max(signals[In], low), high);
+  }
+};
+
+// Couples speed to steering: a speed reference that drops from max_speed
+// by per_cte for each meter of |cte| and per_steer for a full steering
+// command, down to min_speed.
+template <int Out, int Cte, int Steer>
+struct SpeedCoupling {
+  static constexpr int SLOTS = std::max({ Out, Cte, Steer }) + 1;
+
+  double max_speed;
+  double min_speed;
+  double per_cte;
+  double per_steer;
+
+  SpeedCoupling(double max_speed, double min_speed, double per_cte, double per_steer):
+    max_speed(max_speed), min_speed(min_speed), per_cte(per_cte), per_steer(per_steer) {}
+
+  void operator()(double* signals, double) const {
+    double speed = max_speed - per_cte * fabs(signals[Cte]) - per_steer * fabs(signals[Steer]);
+    signals[Out] = std::max(speed, min_speed);
+  }
+};
+
+// Cascaded and coupled loops, as a list of nodes evaluated in order once
+// per frame. The nodes are template parameters and are called through a
+// fold expression, so a graph compiles to one straight sequence of
+// arithmetic on a fixed array, with no virtual calls or loops over nodes.
+// A node that reads a slot written by a later node sees its value from the
+// previous frame: a unit delay.
+template <typename... Nodes>
+class ControllerGraph {
+public:
+  static constexpr int SLOTS = std::max({ 1, Nodes::SLOTS... });
+
+private:
+  std::tuple<Nodes...> nodes;
+  double signals[SLOTS];
+
+public:
+  ControllerGraph(const Nodes&... nodes): nodes(nodes...) {
+    std::fill(signals, signals + SLOTS, 0.0);
+  }
+
+  double& operator[](int slot) { return signals[slot]; }
+  double operator[](int slot) const { return signals[slot]; }
+
+  void operator()(double delta_t) {
+    std::apply([this, delta_t](Nodes&... node) { (node(signals, delta_t), ...); }, nodes);
+  }
+};
+
+#endif
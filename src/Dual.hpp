@@ -0,0 +1,98 @@
+#ifndef __DUAL_H
+#define __DUAL_H
+
+#include <math.h>
+
+// Dual number for forward-mode automatic differentiation: a value together
+// with its partial derivatives with respect to N inputs. Running a
+// computation templated on the scalar type with Dual<N> in place of double
+// gives the exact gradient of the result in a single pass.
+template <int N>
+struct Dual {
+  double v;
+  double d[N];
+
+  Dual(double value = 0): v(value) {
+    for (int k = 0; k < N; k++) d[k] = 0;
+  }
+
+  static Dual variable(double value, int index) {
+    Dual result(value);
+    result.d[index] = 1;
+    return result;
+  }
+
+  Dual& operator+=(const Dual& o) {
+    v += o.v;
+    for (int k = 0; k < N; k++) d[k] += o.d[k];
+    return *this;
+  }
+
+  Dual& operator-=(const Dual& o) {
+    v -= o.v;
+    for (int k = 0; k < N; k++) d[k] -= o.d[k];
+    return *this;
+  }
+
+  Dual& operator*=(const Dual& o) {
+    for (int k = 0; k < N; k++) d[k] = d[k] * o.v + v * o.d[k];
+    v *= o.v;
+    return *this;
+  }
+
+  Dual& operator/=(const Dual& o) {
+    double inv = 1.0 / o.v;
+    for (int k = 0; k < N; k++) d[k] = (d[k] - v * inv * o.d[k]) * inv;
+    v *= inv;
+    return *this;
+  }
+};
+
+// Applies f(x) given f(x.v) and f'(x.v).
+template <int N>
+Dual<N> chain(const Dual<N>& x, double value, double derivative) {
+  Dual<N> result(value);
+  for (int k = 0; k < N; k++) result.d[k] = derivative * x.d[k];
+  return result;
+}
+
+template <int N> Dual<N> operator-(const Dual<N>& a) { return chain(a, -a.v, -1.0); }
+template <int N> Dual<N> operator+(Dual<N> a, const Dual<N>& b) { return a += b; }
+template <int N> Dual<N> operator-(Dual<N> a, const Dual<N>& b) { return a -= b; }
+template <int N> Dual<N> operator*(Dual<N> a, const Dual<N>& b) { return a *= b; }
+template <int N> Dual<N> operator/(Dual<N> a, const Dual<N>& b) { return a /= b; }
+template <int N> Dual<N> operator+(Dual<N> a, double b) { a.v += b; return a; }
+template <int N> Dual<N> operator+(double a, Dual<N> b) { b.v += a; return b; }
+template <int N> Dual<N> operator-(Dual<N> a, double b) { a.v -= b; return a; }
+template <int N> Dual<N> operator-(double a, const Dual<N>& b) { return -b + a; }
+template <int N> Dual<N> operator*(const Dual<N>& a, double b) { return chain(a, a.v * b, b); }
+template <int N> Dual<N> operator*(double a, const Dual<N>& b) { return chain(b, a * b.v, a); }
+template <int N> Dual<N> operator/(const Dual<N>& a, double b) { return chain(a, a.v / b, 1.0 / b); }
+template <int N> Dual<N> operator/(double a, const Dual<N>& b) { return chain(b, a / b.v, -a / (b.v * b.v)); }
+
+template <int N> bool operator<(const Dual<N>& a, const Dual<N>& b) { return a.v < b.v; }
+template <int N> bool operator>(const Dual<N>& a, const Dual<N>& b) { return a.v > b.v; }
+template <int N> bool operator<(const Dual<N>& a, double b) { return a.v < b; }
+template <int N> bool operator>(const Dual<N>& a, double b) { return a.v > b; }
+template <int N> bool operator<(double a, const Dual<N>& b) { return a < b.v; }
+template <int N> bool operator>(double a, const Dual<N>& b) { return a > b.v; }
+template <int N> bool operator!=(const Dual<N>& a, double b) { return a.v != b; }
+
+template <int N> Dual<N> sin(const Dual<N>& x) { return chain(x, ::sin(x.v), ::cos(x.v)); }
+template <int N> Dual<N> cos(const Dual<N>& x) { return chain(x, ::cos(x.v), -::sin(x.v)); }
+template <int N> Dual<N> tan(const Dual<N>& x) {
+  double t = ::tan(x.v);
+  return chain(x, t, 1 + t * t);
+}
+template <int N> Dual<N> sqrt(const Dual<N>& x) {
+  double s = ::sqrt(x.v);
+  return chain(x, s, s > 0 ? 0.5 / s : 0);
+}
+template <int N> Dual<N> fabs(const Dual<N>& x) { return x.v < 0 ? -x : x; }
+template <int N> Dual<N> fmax(const Dual<N>& a, const Dual<N>& b) { return a.v < b.v ? b : a; }
+template <int N> Dual<N> fmin(const Dual<N>& a, const Dual<N>& b) { return b.v < a.v ? b : a; }
+
+inline double value(double x) { return x; }
+template <int N> double value(const Dual<N>& x) { return x.v; }
+
+#endif
@@ -0,0 +1,30 @@
+#include "EpisodeCost.hpp"
+
+bool CostWeights::parse(const std::string& spec, CostWeights& weights) {
+  CostWeights result;
+  result.squared_cte = 0;
+  size_t start = 0;
+  while (start < spec.size()) {
+    size_t end = spec.find(',', start);
+    if (end == std::string::npos) {
+      end = spec.size();
+    }
+    std::string term = spec.substr(start, end - start);
+    size_t eq = term.find('=');
+    std::string name = term.substr(0, eq);
+    double value = eq == std::string::npos ? 1.0 : atof(term.c_str() + eq + 1);
+
+    if (name == "cte") result.squared_cte = value;
+    else if (name == "itae") result.itae = value;
+    else if (name == "effort") result.effort = value;
+    else if (name == "rate") result.steer_rate = value;
+    else if (name == "overshoot") result.overshoot = value;
+    else if (name == "lap") result.lap_time = value;
+    else if (name == "lap_length") result.lap_length = value;
+    else return false;
+
+    start = end + 1;
+  }
+  weights = result;
+  return true;
+}
@@ -0,0 +1,98 @@
+#ifndef __EPISODE_COST_H
+#define __EPISODE_COST_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+
+struct CostWeights {
+  double squared_cte;
+  double itae;
+  double effort;
+  double steer_rate;
+  double overshoot;
+  double lap_time;
+  // Lap time is extrapolated from the average speed over the episode.
+  double lap_length;
+
+  CostWeights():
+    squared_cte(1), itae(0), effort(0), steer_rate(0), overshoot(0), lap_time(0), lap_length(1000) {}
+
+  // Parses a comma-separated list of name=weight pairs, e.g.
+  // "cte=1,itae=0.01,effort=0.1". Terms that aren't listed get zero weight.
+  // Returns false on an unknown term name.
+  static bool parse(const std::string& spec, CostWeights& weights);
+};
+
+// Accumulates the episode cost terms incrementally, in constant time and
+// without allocations per frame:
+//  - squared CTE, per step (what Twiddler originally used),
+//  - ITAE, the integral of time-weighted absolute CTE,
+//  - control effort, the mean |steer| per step,
+//  - mean |steering rate| per step,
+//  - overshoot, the peak |CTE| past the center line after the first crossing,
+//  - lap time, extrapolated from the distance covered so far.
+template <typename T>
+class BasicEpisodeCost {
+  CostWeights weights;
+  double elapsed;
+  T distance;
+  T squared_cte;
+  T itae;
+  T effort;
+  T steer_rate;
+  T prev_steer;
+  T overshoot;
+  int start_side;
+  bool crossed;
+  bool started;
+
+public:
+  static constexpr double MPH = 0.44704;
+
+  BasicEpisodeCost(const CostWeights& weights = CostWeights()):
+    weights(weights),
+    elapsed(0), distance(0),
+    squared_cte(0), itae(0), effort(0), steer_rate(0), prev_steer(0), overshoot(0),
+    start_side(0), crossed(false), started(false) {}
+
+  void operator()(T cte, T steer, T speed, double delta_t) {
+    elapsed += delta_t;
+    distance += speed * MPH * delta_t;
+
+    squared_cte += cte * cte;
+    itae += elapsed * fabs(cte) * delta_t;
+    effort += fabs(steer);
+    if (started && delta_t > 0) {
+      steer_rate += fabs(steer - prev_steer) / delta_t;
+    }
+    prev_steer = steer;
+    started = true;
+
+    int side = (cte > 0) - (cte < 0);
+    if (start_side == 0) {
+      start_side = side;
+    } else if (side == -start_side) {
+      crossed = true;
+    }
+    if (crossed && side == -start_side) {
+      overshoot = fmax(overshoot, fabs(cte));
+    }
+  }
+
+  T squaredCte(int steps) const { return squared_cte / steps; }
+  T lapTime() const { return distance > 0 ? elapsed * weights.lap_length / distance : T(0); }
+
+  T value(int steps) const {
+    return weights.squared_cte * squared_cte / steps
+      + weights.itae * itae
+      + weights.effort * effort / steps
+      + weights.steer_rate * steer_rate / steps
+      + weights.overshoot * overshoot
+      + weights.lap_time * lapTime();
+  }
+};
+
+typedef BasicEpisodeCost<double> EpisodeCost;
+
+#endif
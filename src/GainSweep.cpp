@@ -0,0 +1,89 @@
+#include "GainSweep.hpp"
+
+std::vector<Gains> GainSweep::grid(const Gains& lower, const Gains& upper, int per_axis) {
+  std::vector<Gains> result;
+  double scale = per_axis > 1 ? 1.0 / (per_axis - 1) : 0.0;
+  for (int a = 0; a < per_axis; a++) {
+    for (int b = 0; b < per_axis; b++) {
+      for (int c = 0; c < per_axis; c++) {
+	result.push_back(Gains(lower.p + (upper.p - lower.p) * a * scale,
+			       lower.i + (upper.i - lower.i) * b * scale,
+			       lower.d + (upper.d - lower.d) * c * scale));
+      }
+    }
+  }
+  return result;
+}
+
+std::vector<Gains> GainSweep::latinHypercube(const Gains& lower, const Gains& upper, int samples, unsigned seed) {
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  std::vector<Gains> result(samples, Gains(0, 0, 0));
+  Gains lo(lower), hi(upper);
+  for (int k = 0; k < 3; k++) {
+    std::vector<int> strata(samples);
+    for (int s = 0; s < samples; s++) strata[s] = s;
+    std::shuffle(strata.begin(), strata.end(), random);
+    for (int s = 0; s < samples; s++) {
+      result[s][k] = lo[k] + (hi[k] - lo[k]) * (strata[s] + uniform(random)) / samples;
+    }
+  }
+  return result;
+}
+
+void GainSweep::run() {
+  const std::vector<Scenario>& scenarios = suite.scenarioList();
+  size_t scenario_count = scenarios.size();
+  scores.assign(candidates.size() * scenario_count, 0.0);
+  costs.assign(candidates.size(), 0.0);
+
+  size_t groups = (candidates.size() + LANES - 1) / LANES;
+  std::atomic<size_t> next_group(0);
+  std::vector<std::thread> workers;
+  size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t t = 0; t < std::min(thread_count, groups); t++) {
+    workers.push_back(std::thread([this, &scenarios, &next_group, groups, scenario_count]() {
+	  double lane_scores[LANES];
+	  std::vector<double> candidate_scores(scenario_count);
+	  for (size_t group = next_group++; group < groups; group = next_group++) {
+	    size_t first = group * LANES;
+	    int count = (int)std::min<size_t>(LANES, candidates.size() - first);
+	    for (size_t s = 0; s < scenario_count; s++) {
+	      suite.runEpisodes<LANES>(scenarios[s], &candidates[first], count, lane_scores);
+	      for (int lane = 0; lane < count; lane++) {
+		scores[(first + lane) * scenario_count + s] = lane_scores[lane];
+	      }
+	    }
+	    for (int lane = 0; lane < count; lane++) {
+	      const double* row = &scores[(first + lane) * scenario_count];
+	      candidate_scores.assign(row, row + scenario_count);
+	      costs[first + lane] = suite.combine(candidate_scores);
+	    }
+	  }
+	}));
+  }
+  for (auto& worker: workers) {
+    worker.join();
+  }
+}
+
+bool GainSweep::write(const std::string& path) const {
+  std::ofstream file(path.c_str());
+  if (!file) {
+    return false;
+  }
+  const std::vector<Scenario>& scenarios = suite.scenarioList();
+  file << "p,i,d,cost";
+  for (const Scenario& scenario: scenarios) {
+    file << "," << scenario.name;
+  }
+  file << "\n" << std::setprecision(10);
+  for (size_t c = 0; c < candidates.size(); c++) {
+    file << candidates[c].p << "," << candidates[c].i << "," << candidates[c].d << "," << costs[c];
+    for (size_t s = 0; s < scenarios.size(); s++) {
+      file << "," << scores[c * scenarios.size() + s];
+    }
+    file << "\n";
+  }
+  return (bool)file;
+}
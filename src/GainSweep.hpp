@@ -0,0 +1,55 @@
+#ifndef __GAIN_SWEEP_H
+#define __GAIN_SWEEP_H
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "PidController.hpp"
+#include "ScenarioSuite.hpp"
+
+// Evaluates every candidate of a fixed set of gains on a scenario suite,
+// to map the whole cost landscape rather than a single search path. The
+// candidates are split into groups of LANES that run through each scenario
+// together, and the groups are shared out among all cores.
+class GainSweep {
+  const ScenarioSuite& suite;
+  std::vector<Gains> candidates;
+  // Scenario scores of candidate c at c * scenario count.
+  std::vector<double> scores;
+  std::vector<double> costs;
+
+public:
+  static const int LANES = 8;
+
+  // Every combination of per_axis values spread evenly from lower to upper.
+  static std::vector<Gains> grid(const Gains& lower, const Gains& upper, int per_axis);
+
+  // Latin hypercube sample: every gain takes each of 'samples' equal strata
+  // exactly once, at a random point within the stratum.
+  static std::vector<Gains> latinHypercube(const Gains& lower, const Gains& upper, int samples, unsigned seed = 1);
+
+  GainSweep(const ScenarioSuite& suite, const std::vector<Gains>& candidates):
+    suite(suite),
+    candidates(candidates) {}
+
+  void run();
+
+  size_t size() const { return candidates.size(); }
+  const Gains& candidate(size_t index) const { return candidates[index]; }
+  double cost(size_t index) const { return costs[index]; }
+
+  size_t best() const {
+    return std::min_element(costs.begin(), costs.end()) - costs.begin();
+  }
+
+  // Writes one row per candidate: the gains, the combined cost, and the
+  // score on every scenario. Returns false when the file can't be written.
+  bool write(const std::string& path) const;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef __GRADIENT_TUNER_H
+#define __GRADIENT_TUNER_H
+
+#include <iostream>
+#include <math.h>
+#include "Dual.hpp"
+#include "PidController.hpp"
+
+// Tunes the gains with the Adam optimizer, driven by the exact gradient of
+// the episode cost. The evaluator is anything with a 'Dual<3>
+// gradient(const Gains&)' method, such as ScenarioSuite. Every iteration
+// costs a single pass over the episodes, instead of the two or three
+// passes per gain that twiddle needs to find a direction.
+template <typename Evaluator>
+class GradientTuner {
+  const Evaluator& evaluate;
+  Gains gains;
+  Gains best_result;
+  double best_error;
+  double rate;
+  int max_iterations;
+
+  static constexpr double BETA1 = 0.9;
+  static constexpr double BETA2 = 0.999;
+  static constexpr double EPSILON = 1e-8;
+
+  void report(int iteration, const Dual<3>& error) const {
+    std::cout << "Iteration: " << iteration << std::endl;
+    std::cout << "Current error: " << error.v << std::endl;
+    std::cout << "Current gain values: [" << gains.p << ", " << gains.i << ", " << gains.d << "]" << std::endl;
+    std::cout << "Gradient: [" << error.d[0] << ", " << error.d[1] << ", " << error.d[2] << "]" << std::endl << std::endl;
+  }
+
+public:
+  GradientTuner(const Evaluator& evaluate, const Gains& init_gains, double rate, int max_iterations):
+    evaluate(evaluate),
+    gains(init_gains),
+    best_result(init_gains),
+    best_error(-1),
+    rate(rate),
+    max_iterations(max_iterations) {}
+
+  const Gains& bestResult() const { return best_result; }
+  double bestError() const { return best_error; }
+
+  Gains run() {
+    Gains m(0, 0, 0);
+    Gains v(0, 0, 0);
+
+    for (int iteration = 1; iteration <= max_iterations; iteration++) {
+      Dual<3> error = evaluate.gradient(gains);
+      report(iteration, error);
+      if (best_error < 0 || error.v < best_error) {
+	best_error = error.v;
+	best_result = gains;
+      }
+
+      double largest_step = 0;
+      for (int k = 0; k < 3; k++) {
+	m[k] = BETA1 * m[k] + (1 - BETA1) * error.d[k];
+	v[k] = BETA2 * v[k] + (1 - BETA2) * error.d[k] * error.d[k];
+	double m_hat = m[k] / (1 - pow(BETA1, iteration));
+	double v_hat = v[k] / (1 - pow(BETA2, iteration));
+	double step = rate * m_hat / (sqrt(v_hat) + EPSILON);
+	gains[k] = fmax(0.0, gains[k] - step);
+	largest_step = fmax(largest_step, fabs(step));
+      }
+
+      if (largest_step < rate * 1e-3) {
+	break;
+      }
+    }
+    return best_result;
+  }
+};
+
+#endif
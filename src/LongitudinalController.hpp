@@ -0,0 +1,83 @@
+#ifndef __LONGITUDINAL_CONTROLLER_H
+#define __LONGITUDINAL_CONTROLLER_H
+
+#include <math.h>
+#include "OutputShaping.hpp"
+#include "PidController.hpp"
+
+// Where the car may go fast. Speeds are in mph.
+struct SpeedProfile {
+  double max_speed;
+  double min_speed;
+  // Lateral acceleration allowed in corners, in m/s^2.
+  double max_lateral_accel;
+  // Speed given up per meter of |cte|.
+  double cte_slowdown;
+  // How fast the target may change, in mph/s.
+  double max_target_rate;
+  // Time constants, in s: of the low-pass filter that keeps steering noise
+  // from reading as corners, and with which the corner estimate fades once
+  // the steering straightens.
+  double smoothing;
+  double release;
+  // Steering geometry, to turn a steering command into a curvature.
+  double max_steer;
+  double wheelbase;
+
+  SpeedProfile(double max_speed = 30):
+    max_speed(max_speed), min_speed(15), max_lateral_accel(3), cte_slowdown(5),
+    max_target_rate(8), smoothing(0.5), release(1.5),
+    max_steer(25.0 * M_PI / 180.0), wheelbase(2.67) {}
+};
+
+// Speed control with braking. The target speed comes from the profile: the
+// curvature of the road is estimated from the steering the car needs, and
+// the target is the speed that keeps the lateral acceleration within the
+// limit, lowered further when the car is off the center line. The estimate
+// follows a sharper corner at once but fades slowly, so the car stays slow
+// through the corner, and the target moves at a bounded rate, so braking
+// starts smoothly.
+//
+// The throttle is a feedforward that holds the target against drag and
+// accelerates along with it, plus a PID on the speed error. Negative
+// throttle brakes.
+class LongitudinalController {
+  SpeedProfile profile;
+  PidController speed_pid;
+  // Throttle that holds a speed, per mph, and throttle per mph/s of
+  // acceleration. The defaults are fitted on VehicleModel, not on the
+  // simulator.
+  double hold_feedforward;
+  double accel_feedforward;
+  SlewRate target_slew;
+  double steer_average;
+  double curvature;
+  double target;
+
+public:
+  LongitudinalController(const SpeedProfile& profile, const Gains& gains = Gains(0.1, 0.02, 0),
+			 double hold_feedforward = 0.0045, double accel_feedforward = 0.09):
+    profile(profile),
+    speed_pid(gains, 0),
+    hold_feedforward(hold_feedforward), accel_feedforward(accel_feedforward),
+    target_slew(profile.max_target_rate, profile.max_speed),
+    steer_average(0), curvature(0), target(profile.max_speed) {}
+
+  // 'steer' is the last steering command, in [-1, 1].
+  double operator()(double speed, double cte, double steer, double delta_t) {
+    const double MPH = 0.44704;
+    steer_average += (steer - steer_average) * delta_t / (profile.smoothing + delta_t);
+    double corner = fabs(tan(steer_average * profile.max_steer)) / profile.wheelbase;
+    curvature = fmax(corner, curvature * exp(-delta_t / profile.release));
+    double limit = sqrt(profile.max_lateral_accel / fmax(curvature, 1e-6)) / MPH;
+    limit = fmin(limit, profile.max_speed) - profile.cte_slowdown * fabs(cte);
+    double previous = target;
+    target = target_slew(fmax(limit, profile.min_speed), delta_t);
+    double accel = delta_t > 0 ? (target - previous) / delta_t : 0;
+    return hold_feedforward * target + accel_feedforward * accel + speed_pid(speed - target, delta_t);
+  }
+
+  double targetSpeed() const { return target; }
+};
+
+#endif
@@ -0,0 +1,324 @@
+#ifndef __MPC_STEERING_H
+#define __MPC_STEERING_H
+
+#include <algorithm>
+#include <math.h>
+#include "VehicleModel.hpp"
+
+struct MpcWeights {
+  double offset;
+  double heading;
+  double steer;
+  double steer_rate;
+
+  MpcWeights(): offset(1.0), heading(0.5), steer(0.01), steer_rate(0.5) {}
+};
+
+// Model predictive steering over a horizon of N controller periods. The
+// plant is the bicycle model of VehicleModel, linearized on the road at the
+// current speed and discretized with a zero-order hold at the controller
+// period, with the actuator dead time rounded to whole periods. Its state is
+// the lateral offset and heading error from the center line, the lateral
+// velocity and yaw rate, and a constant heading disturbance that stands for
+// the road curvature: a Kalman filter estimates all of them from the CTE
+// alone, and the disturbance gives offset-free tracking in curves.
+//
+// Every frame minimizes the predicted squared offset and heading error plus
+// the squared steering and steering changes, subject to |steer| <= 1. The
+// QP is condensed to the N steering commands and solved by projected
+// coordinate descent, warm-started from the previous solution shifted by one
+// period. The model is only rebuilt when the speed or period changes, and
+// all the work is done in fixed-size arrays.
+template <int N>
+class MpcSteering {
+  static const int NX = 5;
+  static const int MAX_DELAY = 4;
+  static const int H = N + MAX_DELAY;
+  static const int MAX_SWEEPS = 50;
+
+  VehicleParams params;
+  MpcWeights weights;
+
+  // Model, rebuilt by build().
+  double model_speed;
+  double model_dt;
+  int delay;
+  double phi[NX][NX];
+  double gamma[NX];
+  double gain[NX];
+  // Tracked outputs (offset, heading) after k + 1 steps of free response:
+  // free_offset[k] . x, free_heading[k] . x.
+  double free_offset[H][NX];
+  double free_heading[H][NX];
+  // Response of the outputs k steps after a unit command.
+  double impulse_offset[H];
+  double impulse_heading[H];
+  double hessian[N][N];
+
+  // State estimate, and past commands, newest first.
+  double state[NX];
+  double past[MAX_DELAY + 1];
+  bool started;
+
+  double solution[N];
+
+  static void expm(double m[NX + 1][NX + 1], double out[NX + 1][NX + 1]) {
+    const int n = NX + 1;
+    double norm = 0;
+    for (int r = 0; r < n; r++) {
+      double row = 0;
+      for (int c = 0; c < n; c++) row += fabs(m[r][c]);
+      norm = fmax(norm, row);
+    }
+    int squarings = norm > 0.5 ? (int)ceil(log2(norm / 0.5)) : 0;
+    double scale = ldexp(1.0, -squarings);
+    double term[n][n], next[n][n];
+    for (int r = 0; r < n; r++) {
+      for (int c = 0; c < n; c++) {
+	m[r][c] *= scale;
+	out[r][c] = term[r][c] = r == c ? 1 : 0;
+      }
+    }
+    for (int k = 1; k <= 12; k++) {
+      multiply(term, m, next);
+      for (int r = 0; r < n; r++) {
+	for (int c = 0; c < n; c++) {
+	  term[r][c] = next[r][c] / k;
+	  out[r][c] += term[r][c];
+	}
+      }
+    }
+    for (int s = 0; s < squarings; s++) {
+      multiply(out, out, next);
+      for (int r = 0; r < n; r++) {
+	for (int c = 0; c < n; c++) out[r][c] = next[r][c];
+      }
+    }
+  }
+
+  template <int R>
+  static void multiply(const double a[R][R], const double b[R][R], double out[R][R]) {
+    for (int r = 0; r < R; r++) {
+      for (int c = 0; c < R; c++) {
+	double sum = 0;
+	for (int k = 0; k < R; k++) sum += a[r][k] * b[k][c];
+	out[r][c] = sum;
+      }
+    }
+  }
+
+  // Steady-state Kalman gain for measuring the offset, by iterating the
+  // Riccati equation.
+  void buildObserver() {
+    const double process_noise[NX] = { 1e-4, 1e-4, 1e-2, 1e-2, 1e-4 };
+    const double measurement_noise = 2.5e-3;
+    double p[NX][NX] = {};
+    for (int k = 0; k < NX; k++) p[k][k] = 1;
+
+    for (int iteration = 0; iteration < 300; iteration++) {
+      double pp[NX][NX], predicted[NX][NX];
+      for (int r = 0; r < NX; r++) {
+	for (int c = 0; c < NX; c++) {
+	  double sum = 0;
+	  for (int k = 0; k < NX; k++) sum += phi[r][k] * p[k][c];
+	  pp[r][c] = sum;
+	}
+      }
+      for (int r = 0; r < NX; r++) {
+	for (int c = 0; c < NX; c++) {
+	  double sum = 0;
+	  for (int k = 0; k < NX; k++) sum += pp[r][k] * phi[c][k];
+	  predicted[r][c] = sum + (r == c ? process_noise[r] : 0);
+	}
+      }
+      double innovation = predicted[0][0] + measurement_noise;
+      for (int r = 0; r < NX; r++) {
+	gain[r] = predicted[r][0] / innovation;
+      }
+      for (int r = 0; r < NX; r++) {
+	for (int c = 0; c < NX; c++) {
+	  p[r][c] = predicted[r][c] - gain[r] * predicted[0][c];
+	}
+      }
+    }
+  }
+
+  void build(double speed, double dt) {
+    model_speed = speed;
+    model_dt = dt;
+    double v = fmax(speed, 1.0);
+    double m = params.mass, inertia = params.yaw_inertia;
+    double lf = params.front_axle, lr = params.rear_axle;
+    double cf = params.front_stiffness, cr = params.rear_stiffness;
+
+    // Offset and heading are positive to the left, as in VehicleModel; a
+    // positive command turns right.
+    double a[NX][NX] = {
+      { 0, v, 1, 0, 0 },
+      { 0, 0, 0, 1, -1 },
+      { 0, 0, -(cf + cr) / (m * v), (lr * cr - lf * cf) / (m * v) - v, 0 },
+      { 0, 0, (lr * cr - lf * cf) / (inertia * v), -(lf * lf * cf + lr * lr * cr) / (inertia * v), 0 },
+      { 0, 0, 0, 0, 0 },
+    };
+    double b[NX] = { 0, 0, -params.max_steer * cf / m, -params.max_steer * lf * cf / inertia, 0 };
+
+    double aug[NX + 1][NX + 1] = {}, result[NX + 1][NX + 1];
+    for (int r = 0; r < NX; r++) {
+      for (int c = 0; c < NX; c++) aug[r][c] = a[r][c] * dt;
+      aug[r][NX] = b[r] * dt;
+    }
+    expm(aug, result);
+    for (int r = 0; r < NX; r++) {
+      for (int c = 0; c < NX; c++) phi[r][c] = result[r][c];
+      gamma[r] = result[r][NX];
+    }
+
+    delay = (int)round(params.actuator_delay / dt);
+    delay = delay < 0 ? 0 : (delay > MAX_DELAY ? MAX_DELAY : delay);
+
+    // Rows of phi^(k + 1) for the outputs, and the impulse responses.
+    double row_offset[NX] = { 1, 0, 0, 0, 0 }, row_heading[NX] = { 0, 1, 0, 0, 0 };
+    for (int k = 0; k < H; k++) {
+      impulse_offset[k] = impulse_heading[k] = 0;
+      for (int c = 0; c < NX; c++) {
+	impulse_offset[k] += row_offset[c] * gamma[c];
+	impulse_heading[k] += row_heading[c] * gamma[c];
+      }
+      double next_offset[NX], next_heading[NX];
+      for (int c = 0; c < NX; c++) {
+	next_offset[c] = next_heading[c] = 0;
+	for (int j = 0; j < NX; j++) {
+	  next_offset[c] += row_offset[j] * phi[j][c];
+	  next_heading[c] += row_heading[j] * phi[j][c];
+	}
+      }
+      for (int c = 0; c < NX; c++) {
+	free_offset[k][c] = row_offset[c] = next_offset[c];
+	free_heading[k][c] = row_heading[c] = next_heading[c];
+      }
+    }
+
+    // Hessian of the condensed QP: sum over the predictions of the squared
+    // responses to each pair of commands, plus the input penalties.
+    int steps = N + delay;
+    for (int i = 0; i < N; i++) {
+      for (int j = 0; j < N; j++) {
+	double sum = 0;
+	for (int k = delay + std::max(i, j); k < steps; k++) {
+	  sum += weights.offset * impulse_offset[k - i - delay] * impulse_offset[k - j - delay]
+	    + weights.heading * impulse_heading[k - i - delay] * impulse_heading[k - j - delay];
+	}
+	hessian[i][j] = sum;
+      }
+      hessian[i][i] += weights.steer + 2 * weights.steer_rate;
+      if (i + 1 < N) {
+	hessian[i][i + 1] -= weights.steer_rate;
+	hessian[i + 1][i] -= weights.steer_rate;
+      }
+    }
+    hessian[N - 1][N - 1] -= weights.steer_rate;
+
+    buildObserver();
+  }
+
+  void estimate(double offset) {
+    if (!started) {
+      for (int k = 0; k < NX; k++) state[k] = 0;
+      state[0] = offset;
+      return;
+    }
+    double predicted[NX];
+    for (int r = 0; r < NX; r++) {
+      predicted[r] = gamma[r] * past[delay];
+      for (int c = 0; c < NX; c++) predicted[r] += phi[r][c] * state[c];
+    }
+    double innovation = offset - predicted[0];
+    for (int r = 0; r < NX; r++) {
+      state[r] = predicted[r] + gain[r] * innovation;
+    }
+  }
+
+  void solve() {
+    // Outputs predicted from the current state and the commands already
+    // sent, which still apply during the first 'delay' steps.
+    int steps = N + delay;
+    double base_offset[H], base_heading[H];
+    for (int k = 0; k < steps; k++) {
+      double offset = 0, heading = 0;
+      for (int c = 0; c < NX; c++) {
+	offset += free_offset[k][c] * state[c];
+	heading += free_heading[k][c] * state[c];
+      }
+      for (int m = 0; m < delay && m <= k; m++) {
+	double command = past[delay - 1 - m];
+	offset += impulse_offset[k - m] * command;
+	heading += impulse_heading[k - m] * command;
+      }
+      base_offset[k] = offset;
+      base_heading[k] = heading;
+    }
+
+    double gradient[N];
+    for (int i = 0; i < N; i++) {
+      double sum = 0;
+      for (int k = delay + i; k < steps; k++) {
+	sum += weights.offset * impulse_offset[k - i - delay] * base_offset[k]
+	  + weights.heading * impulse_heading[k - i - delay] * base_heading[k];
+      }
+      gradient[i] = sum;
+    }
+    gradient[0] -= weights.steer_rate * past[0];
+
+    // Warm start from the previous solution, shifted by one period.
+    for (int i = 0; i + 1 < N; i++) solution[i] = solution[i + 1];
+    for (int i = 0; i < N; i++) {
+      for (int j = 0; j < N; j++) gradient[i] += hessian[i][j] * solution[j];
+    }
+
+    for (int sweep = 0; sweep < MAX_SWEEPS; sweep++) {
+      double largest = 0;
+      for (int i = 0; i < N; i++) {
+	double value = fmin(1.0, fmax(-1.0, solution[i] - gradient[i] / hessian[i][i]));
+	double change = value - solution[i];
+	if (change != 0) {
+	  solution[i] = value;
+	  for (int j = 0; j < N; j++) gradient[j] += hessian[j][i] * change;
+	  largest = fmax(largest, fabs(change));
+	}
+      }
+      if (largest < 1e-6) {
+	break;
+      }
+    }
+  }
+
+public:
+  MpcSteering(const VehicleParams& params = VehicleParams(), const MpcWeights& weights = MpcWeights()):
+    params(params), weights(weights),
+    model_speed(-1), model_dt(-1), delay(0), started(false) {
+    for (int k = 0; k <= MAX_DELAY; k++) past[k] = 0;
+    for (int i = 0; i < N; i++) solution[i] = 0;
+  }
+
+  // Returns the steering command for the measured CTE, at the given speed
+  // (in mph) and period.
+  double operator()(double cte, double speed_mph, double delta_t) {
+    if (delta_t <= 0) {
+      return past[0];
+    }
+    double speed = speed_mph * VehicleModel::MPH;
+    if (fabs(speed - model_speed) > 0.5 || fabs(delta_t - model_dt) > 0.1 * model_dt) {
+      build(speed, delta_t);
+    }
+
+    estimate(-cte);
+    started = true;
+    solve();
+
+    for (int k = MAX_DELAY; k > 0; k--) past[k] = past[k - 1];
+    past[0] = solution[0];
+    return solution[0];
+  }
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef __OUTPUT_SHAPING_H
+#define __OUTPUT_SHAPING_H
+
+#include <math.h>
+#include <tuple>
+
+// Stages that shape a controller output on its way to the actuator. Each is
+// called as stage(value, delta_t) and returns the shaped value.
+
+// Limits the output to [low, high].
+struct Clamp {
+  double low;
+  double high;
+
+  Clamp(double low = -1, double high = 1): low(low), high(high) {}
+
+  double operator()(double value, double) const {
+    return value < low ? low : (value > high ? high : value);
+  }
+};
+
+// Limits how fast the output can move, to max_rate per second of delta_t.
+// It starts from 'initial', and holds its value when delta_t is 0.
+class SlewRate {
+  double max_rate;
+  double last;
+
+public:
+  SlewRate(double max_rate, double initial = 0): max_rate(max_rate), last(initial) {}
+
+  double operator()(double value, double delta_t) {
+    double max_change = max_rate * delta_t;
+    double change = value - last;
+    last += change < -max_change ? -max_change : (change > max_change ? max_change : change);
+    return last;
+  }
+
+  void reset(double value = 0) { last = value; }
+};
+
+// Zeroes outputs smaller than width, so that noise around the set point
+// doesn't keep the actuator moving.
+struct Deadband {
+  double width;
+
+  Deadband(double width): width(width) {}
+
+  double operator()(double value, double) const {
+    return fabs(value) < width ? 0 : value;
+  }
+};
+
+// Runs the output through Stages in order. Only the listed stages exist, so
+// OutputShaper<Clamp> is a clamp and OutputShaper<> passes values through:
+// a stage that isn't used costs nothing.
+template <typename... Stages>
+class OutputShaper {
+  std::tuple<Stages...> stages;
+
+public:
+  OutputShaper(const Stages&... stages): stages(stages...) {}
+
+  double operator()(double value, double delta_t) {
+    std::apply([&value, delta_t](Stages&... stage) { ((value = stage(value, delta_t)), ...); }, stages);
+    return value;
+  }
+
+  template <typename Stage>
+  Stage& stage() { return std::get<Stage>(stages); }
+};
+
+#endif
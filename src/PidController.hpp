@@ -1,42 +1,48 @@
 #ifndef __PID_CONTROLLER_H
 #define __PID_CONTROLLER_H
 
-struct Gains {
-  double p;
-  double i;
-  double d;
+#include <assert.h>
+
+// The scalar type is a template parameter so that the controller can be run
+// on dual numbers to differentiate an episode with respect to the gains.
+template <typename T>
+struct BasicGains {
+  T p;
+  T i;
+  T d;
   
-  constexpr Gains(double p, double i, double d): p(p), i(i), d(d) {}
+  constexpr BasicGains(T p, T i, T d): p(p), i(i), d(d) {}
   
-  double& operator[](int index) {
-    switch(index) {
-    case 0: return p;
-    case 1: return i;
-    case 2: return d;
-    default: throw "Invalid index";
-    }
+  // The index is always a loop counter over the three gains, so a bad one
+  // is a bug, not a runtime condition.
+  T& operator[](int index) {
+    assert(index >= 0 && index < 3);
+    return index == 0 ? p : (index == 1 ? i : d);
   }
 };
 
-class PidController {
-  Gains gains;
+typedef BasicGains<double> Gains;
+
+template <typename T>
+class BasicPidController {
+  BasicGains<T> gains;
   double set_point;
-  double error_i;
-  double prev_error;
-  double squared_sum_error;
+  T error_i;
+  T prev_error;
+  T squared_sum_error;
 
 public:
-  PidController(): PidController(Gains(0, 0, 0), 0) {}
-  PidController(const Gains& gains, double set_point):
+  BasicPidController(): BasicPidController(BasicGains<T>(0, 0, 0), 0) {}
+  BasicPidController(const BasicGains<T>& gains, double set_point):
     gains(gains),
     set_point(set_point),
     error_i(0),
     prev_error(0),
     squared_sum_error(0) { }
   
-  double operator()(double measured_value, double delta_t) {
-    double error = set_point - measured_value;
-    double error_d = delta_t != 0 ? (error - prev_error) / delta_t : 0;
+  T operator()(T measured_value, double delta_t) {
+    T error = set_point - measured_value;
+    T error_d = delta_t != 0 ? (error - prev_error) / delta_t : T(0);
 
     error_i += error * delta_t;
     prev_error = error;
@@ -45,7 +51,46 @@ public:
     return gains.p * error + gains.i * error_i + gains.d * error_d;
   }
   
-  double squaredSumError() const { return squared_sum_error; }
+  T squaredSumError() const { return squared_sum_error; }
+};
+
+typedef BasicPidController<double> PidController;
+
+// A bank of W controllers with the same set point, stepped together. The
+// state is kept as arrays of W values, so every step is a handful of loops
+// over contiguous memory that the compiler turns into SIMD instructions.
+template <int W>
+class PidBank {
+  alignas(32) double p[W];
+  alignas(32) double i[W];
+  alignas(32) double d[W];
+  alignas(32) double error_i[W];
+  alignas(32) double prev_error[W];
+  double set_point;
+
+public:
+  PidBank(double set_point = 0): set_point(set_point) {
+    for (int lane = 0; lane < W; lane++) {
+      p[lane] = i[lane] = d[lane] = 0;
+      error_i[lane] = prev_error[lane] = 0;
+    }
+  }
+
+  void setGains(int lane, const Gains& gains) {
+    p[lane] = gains.p;
+    i[lane] = gains.i;
+    d[lane] = gains.d;
+  }
+
+  void operator()(const double* measured_values, double delta_t, double* out) {
+    for (int lane = 0; lane < W; lane++) {
+      double error = set_point - measured_values[lane];
+      double error_d = delta_t != 0 ? (error - prev_error[lane]) / delta_t : 0.0;
+      error_i[lane] += error * delta_t;
+      prev_error[lane] = error;
+      out[lane] = p[lane] * error + i[lane] * error_i[lane] + d[lane] * error_d;
+    }
+  }
 };
 
 #endif
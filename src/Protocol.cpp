@@ -0,0 +1,344 @@
+#include "Protocol.hpp"
+
+#include <charconv>
+#include <math.h>
+#include <string.h>
+
+std::string_view TextProtocol::getData(std::string_view s) {
+  auto found_null = s.find("null");
+  auto b1 = s.find_first_of("[");
+  auto b2 = s.find_last_of("]");
+  if (found_null != std::string_view::npos) {
+    return std::string_view();
+  }
+  else if (b1 != std::string_view::npos && b2 != std::string_view::npos) {
+    return s.substr(b1, b2 - b1 + 1);
+  }
+  return std::string_view();
+}
+
+static size_t skipSpace(std::string_view s, size_t pos) {
+  while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\n' || s[pos] == '\r')) {
+    pos++;
+  }
+  return pos;
+}
+
+// End of the string that starts with the quote at s[pos], past its closing
+// quote, or npos when it isn't closed. A quote closes the string unless an
+// odd number of backslashes precede it, so the search is a memchr even over
+// the camera image.
+static size_t skipString(std::string_view s, size_t pos) {
+  while ((pos = s.find('"', pos + 1)) != std::string_view::npos) {
+    size_t backslashes = 0;
+    while (s[pos - 1 - backslashes] == '\\') {
+      backslashes++;
+    }
+    if (backslashes % 2 == 0) {
+      return pos + 1;
+    }
+  }
+  return pos;
+}
+
+// Position past the name of the event array s, such as "telemetry", with
+// the name in 'name', or npos when s doesn't start with one.
+static size_t eventName(std::string_view s, std::string_view& name) {
+  size_t pos = skipSpace(s, 0);
+  if (pos >= s.size() || s[pos] != '[') {
+    return std::string_view::npos;
+  }
+  pos = skipSpace(s, pos + 1);
+  size_t name_end = pos < s.size() && s[pos] == '"' ? skipString(s, pos) : std::string_view::npos;
+  if (name_end != std::string_view::npos) {
+    name = s.substr(pos + 1, name_end - pos - 2);
+  }
+  return name_end;
+}
+
+static bool hasEscape(std::string_view s) {
+  return memchr(s.data(), '\\', s.size()) != nullptr;
+}
+
+// End of the object or array that starts at s[pos], or npos when it isn't
+// closed.
+static size_t skipNested(std::string_view s, size_t pos) {
+  int depth = 0;
+  for (; pos < s.size(); pos++) {
+    char c = s[pos];
+    if (c == '"') {
+      pos = skipString(s, pos);
+      if (pos == std::string_view::npos) {
+	return pos;
+      }
+      pos--;
+    } else if (c == '{' || c == '[') {
+      depth++;
+    } else if ((c == '}' || c == ']') && --depth == 0) {
+      return pos + 1;
+    }
+  }
+  return std::string_view::npos;
+}
+
+static bool endsToken(char c) {
+  return c == ',' || c == '}' || c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+    c == '"' || c == '{' || c == '[' || c == ']' || c == ':';
+}
+
+bool TextProtocol::scanObject(std::string_view s, size_t& pos, NumberField* fields, int count) {
+  for (int k = 0; k < count; k++) {
+    fields[k].found = false;
+  }
+  pos = skipSpace(s, pos);
+  if (pos >= s.size() || s[pos] != '{') {
+    return false;
+  }
+  pos = skipSpace(s, pos + 1);
+  if (pos < s.size() && s[pos] == '}') {
+    pos++;
+    return true;
+  }
+
+  while (true) {
+    if (pos >= s.size() || s[pos] != '"') {
+      return false;
+    }
+    size_t key_end = skipString(s, pos);
+    if (key_end == std::string_view::npos) {
+      return false;
+    }
+    std::string_view key = s.substr(pos + 1, key_end - pos - 2);
+    if (hasEscape(key)) {
+      return false;
+    }
+    pos = skipSpace(s, key_end);
+    if (pos >= s.size() || s[pos] != ':') {
+      return false;
+    }
+    pos = skipSpace(s, pos + 1);
+    if (pos >= s.size()) {
+      return false;
+    }
+
+    NumberField* field = nullptr;
+    for (int k = 0; k < count; k++) {
+      if (fields[k].key == key) {
+	field = &fields[k];
+      }
+    }
+    if (field && field->found) {
+      return false;
+    }
+
+    size_t value_start, value_end;
+    if (s[pos] == '"') {
+      size_t end = skipString(s, pos);
+      if (end == std::string_view::npos) {
+	return false;
+      }
+      value_start = pos + 1;
+      value_end = end - 1;
+      pos = end;
+    } else if (s[pos] == '{' || s[pos] == '[') {
+      pos = field ? std::string_view::npos : skipNested(s, pos);
+      if (pos == std::string_view::npos) {
+	return false;
+      }
+      value_start = value_end = pos;
+    } else {
+      // A number or a literal.
+      value_start = pos;
+      while (pos < s.size() && !endsToken(s[pos])) {
+	pos++;
+      }
+      if (pos == s.size() || pos == value_start || s[pos] == '"' || s[pos] == '{' || s[pos] == '[' ||
+	  s[pos] == ']' || s[pos] == ':') {
+	return false;
+      }
+      value_end = pos;
+    }
+    if (field) {
+      // An escape in a number would be malformed anyway.
+      const char* end = s.data() + value_end;
+      auto result = std::from_chars(s.data() + value_start, end, *field->value);
+      if (result.ec != std::errc() || result.ptr != end) {
+	return false;
+      }
+      field->found = true;
+    }
+
+    pos = skipSpace(s, pos);
+    if (pos >= s.size()) {
+      return false;
+    }
+    if (s[pos] == '}') {
+      pos++;
+      return true;
+    }
+    if (s[pos] != ',') {
+      return false;
+    }
+    pos = skipSpace(s, pos + 1);
+  }
+}
+
+bool TextProtocol::findNumber(std::string_view s, std::string_view key, double& value) {
+  size_t pos = s.find('{');
+  NumberField field = { key, &value, false };
+  return pos != std::string_view::npos && scanObject(s, pos, &field, 1) && field.found;
+}
+
+bool TextProtocol::isTelemetry(std::string_view s) {
+  std::string_view name;
+  return eventName(s, name) != std::string_view::npos && name == "telemetry";
+}
+
+ParseStatus TextProtocol::parseTelemetry(std::string_view s, Measurement& m) {
+  std::string_view name;
+  size_t name_end = eventName(s, name);
+  if (name_end == std::string_view::npos) {
+    return ParseStatus::MALFORMED;
+  }
+  if (name != "telemetry") {
+    return ParseStatus::OTHER_EVENT;
+  }
+  size_t pos = skipSpace(s, name_end);
+  if (pos >= s.size() || s[pos] != ',') {
+    return ParseStatus::MALFORMED;
+  }
+  pos++;
+
+  double cte, speed, angle, time;
+  NumberField fields[] = {
+    { "cte", &cte, false },
+    { "speed", &speed, false },
+    { "steering_angle", &angle, false },
+    { "time", &time, false },
+  };
+  if (!scanObject(s, pos, fields, 4) || !fields[0].found || !fields[1].found || !fields[2].found) {
+    return ParseStatus::MALFORMED;
+  }
+  pos = skipSpace(s, pos);
+  if (pos + 1 != s.size() || s[pos] != ']') {
+    return ParseStatus::MALFORMED;
+  }
+  if (!isfinite(cte) || !isfinite(speed) || !isfinite(angle) || (fields[3].found && !isfinite(time))) {
+    return ParseStatus::MALFORMED;
+  }
+  m.cte = cte;
+  m.speed = speed;
+  m.angle = angle;
+  m.time = fields[3].found ? time : -1;
+  return ParseStatus::OK;
+}
+
+size_t TextProtocol::control(double steer_angle, double throttle, char* out) {
+  char* end = out + MAX_CONTROL_SIZE;
+  char* p = append(out, "42[\"steer\",{\"steering_angle\":");
+  p = appendNumber(p, end, steer_angle);
+  p = append(p, ",\"throttle\":");
+  p = appendNumber(p, end, throttle);
+  p = append(p, "}]");
+  return p - out;
+}
+
+char* TextProtocol::append(char* p, std::string_view s) {
+  memcpy(p, s.data(), s.size());
+  return p + s.size();
+}
+
+char* TextProtocol::appendNumber(char* p, char* end, double value) {
+  if (!isfinite(value)) {
+    return append(p, "null");
+  }
+  return std::to_chars(p, end, value).ptr;
+}
+
+void BinaryProtocol::putDouble(char* out, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 8; i++) {
+    out[i] = (char)(bits >> (8 * i));
+  }
+}
+
+double BinaryProtocol::getDouble(const char* in) {
+  uint64_t bits = 0;
+  for (int i = 0; i < 8; i++) {
+    bits |= (uint64_t)(uint8_t)in[i] << (8 * i);
+  }
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void BinaryProtocol::encode(const BinaryFrame& frame, char* out) {
+  memset(out, 0, HEADER_SIZE);
+  out[0] = (char)frame.type;
+  out[1] = (char)frame.flags;
+  putDouble(out + HEADER_SIZE, frame.cte);
+  putDouble(out + HEADER_SIZE + 8, frame.speed);
+  putDouble(out + HEADER_SIZE + 16, frame.angle);
+  putDouble(out + HEADER_SIZE + 24, frame.steer);
+  putDouble(out + HEADER_SIZE + 32, frame.throttle);
+  putDouble(out + HEADER_SIZE + 40, frame.time);
+}
+
+bool BinaryProtocol::decode(const char* data, size_t length, BinaryFrame& frame) {
+  if (length != FRAME_SIZE) {
+    return false;
+  }
+  frame.type = (uint8_t)data[0];
+  frame.flags = (uint8_t)data[1];
+  frame.cte = getDouble(data + HEADER_SIZE);
+  frame.speed = getDouble(data + HEADER_SIZE + 8);
+  frame.angle = getDouble(data + HEADER_SIZE + 16);
+  frame.steer = getDouble(data + HEADER_SIZE + 24);
+  frame.throttle = getDouble(data + HEADER_SIZE + 32);
+  frame.time = getDouble(data + HEADER_SIZE + 40);
+  return true;
+}
+
+FrameKind classifyFrame(const char* data, size_t length, Protocol protocol, std::string_view& payload, BinaryFrame& frame) {
+  if (protocol == Protocol::BINARY) {
+    if (!BinaryProtocol::decode(data, length, frame)) {
+      return FrameKind::MALFORMED;
+    }
+    return frame.type == BinaryFrame::MANUAL ? FrameKind::MANUAL : FrameKind::EVENT;
+  }
+
+  if (!TextProtocol::isValidData(data, length)) {
+    return FrameKind::IGNORED;
+  }
+  payload = TextProtocol::getData(std::string_view(data, length));
+  return !payload.empty() ? FrameKind::EVENT : FrameKind::MANUAL;
+}
+
+bool isTelemetryFrame(const char* data, size_t length, Protocol protocol) {
+  std::string_view payload;
+  BinaryFrame frame;
+  FrameKind kind = classifyFrame(data, length, protocol, payload, frame);
+  if (kind != FrameKind::EVENT) {
+    return false;
+  }
+  return protocol == Protocol::BINARY ? frame.type == BinaryFrame::TELEMETRY : TextProtocol::isTelemetry(payload);
+}
+
+ParseStatus parseMeasurement(std::string_view payload, const BinaryFrame& frame, Protocol protocol, Measurement& m) {
+  if (protocol == Protocol::TEXT) {
+    return TextProtocol::parseTelemetry(payload, m);
+  }
+  if (frame.type != BinaryFrame::TELEMETRY) {
+    return ParseStatus::OTHER_EVENT;
+  }
+  bool lockstep = frame.flags & BinaryFrame::LOCKSTEP;
+  if (!isfinite(frame.cte) || !isfinite(frame.speed) || !isfinite(frame.angle) || (lockstep && !isfinite(frame.time))) {
+    return ParseStatus::MALFORMED;
+  }
+  m.cte = frame.cte;
+  m.speed = frame.speed;
+  m.angle = frame.angle;
+  m.time = lockstep ? frame.time : -1;
+  return ParseStatus::OK;
+}
@@ -0,0 +1,139 @@
+#ifndef __PROTOCOL_H
+#define __PROTOCOL_H
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+
+enum class Protocol { TEXT, BINARY };
+
+struct Measurement {
+  // Identifies the simulator connection the measurement came from.
+  int session;
+  int step;
+  double delta_t;
+  double cte;
+  double speed;
+  double angle;
+  // Simulated timestamp in seconds when the simulator runs in lockstep,
+  // negative when it runs freely.
+  double time;
+};
+
+enum class ParseStatus {
+  OK,
+  // A well-formed event other than telemetry.
+  OTHER_EVENT,
+  // Not in the shape the simulator sends, or with a value that isn't a
+  // finite number.
+  MALFORMED
+};
+
+// Text frames in the socket.io style the Unity simulator speaks:
+// 42["telemetry",{...}] in, 42["steer",{...}] out.
+class TextProtocol {
+  struct NumberField {
+    std::string_view key;
+    double* value;
+    bool found;
+  };
+
+  // Scans the JSON object that starts at s[pos] in one pass, without
+  // allocating or throwing. The wanted fields are parsed as numbers, quoted
+  // or not, nested values are skipped, and pos is left past the object.
+  // Returns false for anything it can't read exactly as a JSON parser would:
+  // an escape in a key, a wanted key that repeats or holds anything but a
+  // number, or a syntax error around the wanted fields.
+  static bool scanObject(std::string_view s, size_t& pos, NumberField* fields, int count);
+
+  static char* append(char* p, std::string_view s);
+  // Shortest representation that reads back exactly; null for values that
+  // JSON can't represent, as the JSON library writes them.
+  static char* appendNumber(char* p, char* end, double value);
+
+public:
+  static bool isValidData(const char* data, size_t length) {
+    return length && length > 2 && data[0] == '4' && data[1] == '2';
+  }
+
+  // The JSON array of the frame, as a view into it.
+  static std::string_view getData(std::string_view s);
+
+  // Parses the number, quoted or not, of member 'key' of the first object
+  // in s.
+  static bool findNumber(std::string_view s, std::string_view key, double& value);
+
+  // Whether the event array of a frame is a telemetry event, read no
+  // further than its name.
+  static bool isTelemetry(std::string_view s);
+
+  // Picks the telemetry fields out of the event array of a frame.
+  static ParseStatus parseTelemetry(std::string_view s, Measurement& m);
+
+  static const size_t MAX_CONTROL_SIZE = 128;
+
+  // Writes the steer message to out, which holds MAX_CONTROL_SIZE bytes, and
+  // returns its length.
+  static size_t control(double steer_angle, double throttle, char* out);
+
+  static std::string manual() { return "42[\"manual\",{}]"; }
+  static std::string reset() { return "42[\"reset\",{}]"; }
+};
+
+// Compact binary frames for headless simulators: an 8-byte header carrying
+// the frame type and flags, followed by little-endian doubles at fixed
+// offsets. The same layout is used in both directions; fields that don't
+// apply to a frame type are sent as zeros.
+struct BinaryFrame {
+  enum Type : uint8_t {
+    TELEMETRY = 1,
+    MANUAL = 2,
+    STEER = 3,
+    RESET = 4
+  };
+
+  enum Flags : uint8_t {
+    // The simulator waits for a reply to each frame before advancing, and
+    // 'time' carries its simulated clock.
+    LOCKSTEP = 1
+  };
+
+  uint8_t type;
+  uint8_t flags;
+  double cte;
+  double speed;
+  double angle;
+  double steer;
+  double throttle;
+  double time;
+
+  BinaryFrame(uint8_t type = MANUAL):
+    type(type), flags(0), cte(0), speed(0), angle(0), steer(0), throttle(0), time(0) {}
+};
+
+class BinaryProtocol {
+  static void putDouble(char* out, double value);
+  static double getDouble(const char* in);
+
+public:
+  static const size_t HEADER_SIZE = 8;
+  static const size_t FRAME_SIZE = HEADER_SIZE + 6 * sizeof(double);
+  static void encode(const BinaryFrame& frame, char* out);
+  static bool decode(const char* data, size_t length, BinaryFrame& frame);
+};
+
+enum class FrameKind { IGNORED, MANUAL, EVENT, MALFORMED };
+
+// Text frames come from the Unity simulator; binary frames from our
+// headless simulators. The reply always mirrors the protocol of the
+// incoming frame, so each connection negotiates its protocol implicitly.
+FrameKind classifyFrame(const char* data, size_t length, Protocol protocol, std::string_view& payload, BinaryFrame& frame);
+
+// Whether a frame carries telemetry, rather than a manual frame, another
+// event or something unreadable.
+bool isTelemetryFrame(const char* data, size_t length, Protocol protocol);
+
+// Fills in the telemetry fields of m from a frame classified as an event.
+ParseStatus parseMeasurement(std::string_view payload, const BinaryFrame& frame, Protocol protocol, Measurement& m);
+
+#endif
@@ -0,0 +1,100 @@
+#include "RelayAutotune.hpp"
+
+double RelayExperiment::operator()(double cte, double delta_t) {
+  double error = -cte;
+  double rate = time > 0 && delta_t > 0 ? (error - prev_error) / delta_t : 0;
+  double signal = error + lead * rate;
+  prev_error = error;
+  time += delta_t;
+  cycle_min = fmin(cycle_min, signal);
+  cycle_max = fmax(cycle_max, signal);
+
+  if (output < 0 && signal > hysteresis) {
+    output = amplitude;
+    // A cycle ends on every switch to the positive output.
+    if (cycles >= warmup_cycles) {
+      period_sum += time - cycle_start;
+      swing_sum += (cycle_max - cycle_min) / 2;
+    }
+    cycles++;
+    cycle_start = time;
+    cycle_min = cycle_max = signal;
+  } else if (output > 0 && signal < -hysteresis) {
+    output = -amplitude;
+  }
+  return output;
+}
+
+Gains RelayExperiment::gains(TuningRule rule) const {
+  double ku = ultimateGain();
+  double pu = ultimatePeriod();
+  double kp, ti, td;
+  if (rule == TuningRule::ZIEGLER_NICHOLS) {
+    kp = 0.6 * ku;
+    ti = pu / 2;
+    td = pu / 8;
+  } else {
+    kp = ku / 2.2;
+    ti = 2.2 * pu;
+    td = pu / 6.3;
+  }
+  return Gains(kp, kp / ti, kp * (td + lead));
+}
+
+bool parseTuningRule(const std::string& name, TuningRule& rule) {
+  if (name == "zn") {
+    rule = TuningRule::ZIEGLER_NICHOLS;
+  } else if (name == "tl") {
+    rule = TuningRule::TYREUS_LUYBEN;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+Gains seedIncrements(const Gains& gains) {
+  return Gains(fmax(0.25 * gains.p, 0.005), fmax(0.25 * gains.i, 0.005), fmax(0.25 * gains.d, 0.005));
+}
+
+void reportRelayResult(const RelayExperiment& relay, const Gains& gains) {
+  std::cout << "Ultimate gain: " << relay.ultimateGain() << ", period: " << relay.ultimatePeriod() << " s" << std::endl;
+  std::cout << "Tuned gains: [" << gains.p << ", " << gains.i << ", " << gains.d << "]" << std::endl << std::endl;
+}
+
+bool runRelayOffline(RelayExperiment& relay, const VehicleParams& params, double speed, double delta_t,
+		     int max_steps) {
+  VehicleModel plant(params, 0, 0, 0, speed);
+  PidController throttle_controller(Gains(0.8, 0, 0), speed);
+  for (int step = 0; step < max_steps && !relay.hasFinished(); step++) {
+    double steer = relay(-plant.y(), delta_t);
+    double throttle = throttle_controller(plant.speed(), delta_t);
+    plant.step(steer, throttle, delta_t);
+  }
+  return relay.hasFinished();
+}
+
+void RelayTwiddler::startTwiddle(SimulatorResponder& responder, const Gains& gains) {
+  twiddler = Twiddler<>(max_steps, max_cte, speed, gains, seedIncrements(gains), cost_weights);
+  tuned = true;
+  responder.reset();
+}
+
+void RelayTwiddler::operator()(SimulatorResponder& responder, const Measurement& m) {
+  if (tuned) {
+    twiddler(responder, m);
+    return;
+  }
+
+  if (relay.hasFinished()) {
+    Gains gains = relay.gains(rule);
+    reportRelayResult(relay, gains);
+    startTwiddle(responder, gains);
+  } else if (m.step >= max_steps || fabs(m.cte) > max_cte) {
+    std::cout << "No relay limit cycle, twiddling from the default gains" << std::endl << std::endl;
+    startTwiddle(responder, fallback_gains);
+  } else {
+    double steer = relay(m.cte, m.delta_t);
+    double throttle = throttle_controller(m.speed, m.delta_t);
+    responder.control(steer, throttle);
+  }
+}
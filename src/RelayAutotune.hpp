@@ -0,0 +1,113 @@
+#ifndef __RELAY_AUTOTUNE_H
+#define __RELAY_AUTOTUNE_H
+
+#include <iostream>
+#include <math.h>
+#include <string>
+#include "PidController.hpp"
+#include "Responder.hpp"
+#include "Twiddler.hpp"
+#include "VehicleModel.hpp"
+
+enum class TuningRule { ZIEGLER_NICHOLS, TYREUS_LUYBEN };
+
+// Relay feedback experiment (Astrom-Hagglund): the steering switches between
+// +amplitude and -amplitude whenever the error crosses the hysteresis band,
+// which drives the loop into a limit cycle at its ultimate frequency. The
+// period of the cycle is the ultimate period, and its amplitude gives the
+// ultimate gain from the describing function of the relay.
+//
+// The CTE responds to steering like a double integrator, whose phase never
+// rises above -180 degrees, so a relay on the CTE alone has no limit cycle
+// to settle into. The relay therefore switches on the error plus 'lead'
+// times its rate, and the lead is added back to the derivative time of the
+// tuned gains.
+class RelayExperiment {
+  double amplitude;
+  double hysteresis;
+  double lead;
+  int warmup_cycles;
+  int measured_cycles;
+
+  double output;
+  double prev_error;
+  double time;
+  int cycles;
+  double cycle_start;
+  double cycle_min;
+  double cycle_max;
+  double period_sum;
+  double swing_sum;
+
+public:
+  RelayExperiment(double amplitude = 0.1, double hysteresis = 0.02, double lead = 0.5,
+		  int warmup_cycles = 2, int measured_cycles = 4):
+    amplitude(amplitude), hysteresis(hysteresis), lead(lead),
+    warmup_cycles(warmup_cycles), measured_cycles(measured_cycles),
+    output(amplitude), prev_error(0), time(0), cycles(-1), cycle_start(0),
+    cycle_min(0), cycle_max(0), period_sum(0), swing_sum(0) {}
+
+  // Returns the steering for the given CTE.
+  double operator()(double cte, double delta_t);
+
+  bool hasFinished() const { return cycles >= warmup_cycles + measured_cycles; }
+
+  double ultimatePeriod() const { return period_sum / measured_cycles; }
+
+  // Describing function of a relay with hysteresis, for an oscillation of
+  // amplitude a: N(a) = 4 d / (pi sqrt(a^2 - e^2)).
+  double ultimateGain() const {
+    double swing = swing_sum / measured_cycles;
+    return 4 * amplitude / (M_PI * sqrt(fmax(swing * swing - hysteresis * hysteresis, 1e-12)));
+  }
+
+  Gains gains(TuningRule rule) const;
+};
+
+bool parseTuningRule(const std::string& name, TuningRule& rule);
+
+// Twiddle increments for a search seeded with the tuned gains: a fraction
+// of each gain, so that the first epoch probes around the relay estimate.
+Gains seedIncrements(const Gains& gains);
+
+void reportRelayResult(const RelayExperiment& relay, const Gains& gains);
+
+// Runs the relay experiment on the in-process vehicle, driving straight at
+// a constant speed. Returns false if no limit cycle settles within
+// max_steps.
+bool runRelayOffline(RelayExperiment& relay, const VehicleParams& params, double speed, double delta_t,
+		     int max_steps);
+
+// Runs the relay experiment in the first episode against the simulator,
+// then twiddles from the gains it yields.
+class RelayTwiddler {
+  RelayExperiment relay;
+  TuningRule rule;
+  PidController throttle_controller;
+  Twiddler<> twiddler;
+  bool tuned;
+  int max_steps;
+  double max_cte;
+  double speed;
+  Gains fallback_gains;
+  CostWeights cost_weights;
+
+  void startTwiddle(SimulatorResponder& responder, const Gains& gains);
+
+public:
+  RelayTwiddler(int max_steps, double max_cte, double speed, const Gains& fallback_gains, TuningRule rule,
+		const CostWeights& cost_weights = CostWeights()):
+    rule(rule),
+    throttle_controller(Gains(0.8, 0, 0), speed),
+    twiddler(max_steps, max_cte, speed, fallback_gains, seedIncrements(fallback_gains), cost_weights),
+    tuned(false),
+    max_steps(max_steps),
+    max_cte(max_cte),
+    speed(speed),
+    fallback_gains(fallback_gains),
+    cost_weights(cost_weights) {}
+
+  void operator()(SimulatorResponder& responder, const Measurement& m);
+};
+
+#endif
@@ -0,0 +1,40 @@
+#include "Responder.hpp"
+
+void SimulatorResponder::send(const std::string& msg) {
+  sink.send(msg.data(), msg.length(), Protocol::TEXT);
+}
+
+void SimulatorResponder::send(const BinaryFrame& frame) {
+  char msg[BinaryProtocol::FRAME_SIZE];
+  BinaryProtocol::encode(frame, msg);
+  sink.send(msg, sizeof(msg), Protocol::BINARY);
+}
+
+void SimulatorResponder::control(double steer_angle, double throttle) {
+  if (protocol == Protocol::BINARY) {
+    BinaryFrame frame(BinaryFrame::STEER);
+    frame.steer = steer_angle;
+    frame.throttle = throttle;
+    send(frame);
+  } else {
+    char msg[TextProtocol::MAX_CONTROL_SIZE];
+    sink.send(msg, TextProtocol::control(steer_angle, throttle, msg), Protocol::TEXT);
+  }
+}
+
+void SimulatorResponder::manual() {
+  if (protocol == Protocol::BINARY) {
+    send(BinaryFrame(BinaryFrame::MANUAL));
+  } else {
+    send(TextProtocol::manual());
+  }
+}
+
+void SimulatorResponder::reset() {
+  if (protocol == Protocol::BINARY) {
+    send(BinaryFrame(BinaryFrame::RESET));
+  } else {
+    send(TextProtocol::reset());
+  }
+  reset_detected = true;
+}
@@ -0,0 +1,42 @@
+#ifndef __RESPONDER_H
+#define __RESPONDER_H
+
+#include <string>
+#include "Protocol.hpp"
+
+// Where the replies go: the socket of a simulator, or anything else that
+// consumes frames, such as a telemetry replay.
+class FrameSink {
+public:
+  virtual ~FrameSink() {}
+  virtual void send(const char* data, size_t length, Protocol protocol) = 0;
+};
+
+class SimulatorResponder {
+  FrameSink& sink;
+  Protocol protocol;
+  bool reset_detected;
+  bool stop_requested;
+  
+  void send(const std::string& msg);
+  void send(const BinaryFrame& frame);
+  
+public:
+  SimulatorResponder(FrameSink& sink, Protocol protocol = Protocol::TEXT):
+    sink(sink), protocol(protocol), reset_detected(false), stop_requested(false) {}
+
+  void control(double steer_angle, double throttle);
+  void manual();
+  void reset();
+  // Drives straight without throttle, the reply to a frame that can't be
+  // read.
+  void failSafe() { control(0, 0); }
+  // Asks whoever feeds the controller to stop once this frame is handled,
+  // as when a search has finished.
+  void stop() { stop_requested = true; }
+
+  bool wasReset() const { return reset_detected; }
+  bool wasStopped() const { return stop_requested; }
+};
+
+#endif
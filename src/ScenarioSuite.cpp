@@ -0,0 +1,44 @@
+#include "ScenarioSuite.hpp"
+
+ScenarioSuite::ScenarioSuite(const std::vector<Scenario>& scenarios, int max_steps, double max_cte, double delta_t,
+			     Aggregate aggregate, double cvar_alpha):
+  scenarios(scenarios),
+  max_steps(max_steps),
+  max_cte(max_cte),
+  delta_t(delta_t),
+  aggregate(aggregate),
+  cvar_alpha(cvar_alpha) {
+  for (Scenario& scenario: this->scenarios) {
+    if (!scenario.track) {
+      double length = 1.5 * max_steps * delta_t * scenario.speed * VehicleModel::MPH + 50;
+      scenario.track = std::make_shared<Track>(Track::arc(scenario.curvature, length));
+    }
+  }
+}
+
+std::vector<Scenario> ScenarioSuite::standardScenarios() {
+  return {
+    { "straight", 1.0, 0.0, 30.0, 0.0, 0.0, 0.0, 1 },
+    { "straight-fast", -1.5, 0.05, 50.0, 0.0, 0.0, 0.0, 2 },
+    { "left-curve", 0.0, 0.0, 40.0, -1.0 / 150, 0.0, 0.0, 3 },
+    { "right-curve", 0.5, 0.0, 40.0, 1.0 / 120, 0.0, 0.0, 4 },
+    { "tight-curve", 0.0, 0.0, 30.0, -1.0 / 60, 0.0, 0.0, 5 },
+    { "crosswind", 0.0, 0.0, 40.0, 0.0, 1.0, 0.0, 6 },
+    { "noisy-curve", 0.0, 0.0, 40.0, 1.0 / 100, 0.0, 0.05, 7 },
+    { "gusty-fast", 0.5, -0.05, 50.0, -1.0 / 200, -0.7, 0.05, 8 },
+  };
+}
+
+void ScenarioSuite::setTrack(const Track& track) {
+  std::shared_ptr<const Track> shared = std::make_shared<Track>(track);
+  for (Scenario& scenario: scenarios) {
+    scenario.track = shared;
+  }
+}
+
+Dual<3> ScenarioSuite::gradient(const Gains& gains) const {
+  BasicGains<Dual<3> > dual_gains(Dual<3>::variable(gains.p, 0),
+				  Dual<3>::variable(gains.i, 1),
+				  Dual<3>::variable(gains.d, 2));
+  return evaluate(dual_gains);
+}
@@ -0,0 +1,237 @@
+#ifndef __SCENARIO_SUITE_H
+#define __SCENARIO_SUITE_H
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Dual.hpp"
+#include "EpisodeCost.hpp"
+#include "PidController.hpp"
+#include "Track.hpp"
+#include "VehicleModel.hpp"
+
+struct Scenario {
+  std::string name;
+  double start_cte;
+  double start_heading;
+  double speed;
+  // Road curvature in 1/m, positive when the road turns right.
+  double curvature;
+  // Side wind, as a lateral acceleration in m/s^2 (positive to the right).
+  double wind;
+  double noise;
+  unsigned seed;
+  // Track to drive on; ScenarioSuite fills in a road of the given curvature
+  // when it is left empty.
+  std::shared_ptr<const Track> track;
+};
+
+enum class Aggregate { MEAN, WORST, CVAR };
+
+// Scores a set of gains on several episodes of the in-process plant. The
+// episodes are independent, so they run in parallel and a whole suite costs
+// about as much wall-clock time as its longest episode.
+class ScenarioSuite {
+  std::vector<Scenario> scenarios;
+  int max_steps;
+  double max_cte;
+  double delta_t;
+  Aggregate aggregate;
+  double cvar_alpha;
+  CostWeights cost_weights;
+  VehicleParams vehicle_params;
+
+  template <typename T>
+  T aggregateScores(std::vector<T> scores) const {
+    std::sort(scores.begin(), scores.end(), std::greater<T>());
+    if (aggregate == Aggregate::WORST) {
+      return scores.front();
+    }
+
+    size_t count = scores.size();
+    if (aggregate == Aggregate::CVAR) {
+      count = std::max<size_t>(1, (size_t)ceil(cvar_alpha * scores.size()));
+    }
+    T sum = 0;
+    for (size_t i = 0; i < count; i++) {
+      sum += scores[i];
+    }
+    return sum / count;
+  }
+
+  template <typename T>
+  BasicVehicleModel<T> startVehicle(const Scenario& scenario) const {
+    double x, y, heading;
+    scenario.track->pose(0, x, y, heading);
+    BasicVehicleModel<T> plant(vehicle_params,
+			       x + scenario.start_cte * sin(heading), y - scenario.start_cte * cos(heading),
+			       heading - scenario.start_heading, scenario.speed);
+    plant.setWind(-scenario.wind);
+    return plant;
+  }
+
+public:
+  ScenarioSuite(const std::vector<Scenario>& scenarios, int max_steps, double max_cte, double delta_t,
+		Aggregate aggregate = Aggregate::MEAN, double cvar_alpha = 0.25);
+
+  static std::vector<Scenario> standardScenarios();
+
+  void setAggregate(Aggregate value) { aggregate = value; }
+  void setCostWeights(const CostWeights& value) { cost_weights = value; }
+  void setVehicleParams(const VehicleParams& value) { vehicle_params = value; }
+
+  // Runs every scenario on the given track instead of its own road.
+  void setTrack(const Track& track);
+
+  // Same scoring as Twiddler: the episode cost (by default the mean squared
+  // CTE per step), with a large penalty when the car leaves the road before
+  // the episode is over.
+  template <typename T>
+  T runEpisode(const Scenario& scenario, const BasicGains<T>& gains) const {
+    const Track& track = *scenario.track;
+    BasicVehicleModel<T> plant = startVehicle<T>(scenario);
+    int segment = -1;
+    BasicPidController<T> steer_controller(gains, 0);
+    BasicEpisodeCost<T> cost(cost_weights);
+    BasicPidController<T> throttle_controller(BasicGains<T>(0.8, 0, 0), scenario.speed);
+    std::mt19937 random(scenario.seed);
+    std::normal_distribution<double> noise(0, scenario.noise > 0 ? scenario.noise : 1);
+
+    for (int step = 1; step <= max_steps; step++) {
+      T cte = track.cte(plant.x(), plant.y(), segment) + (scenario.noise > 0 ? noise(random) : 0);
+      if (fabs(cte) > max_cte) {
+	return cost.value(step) + 1e6 / step;
+      }
+      T steer = steer_controller(cte, delta_t);
+      T throttle = throttle_controller(plant.speed(), delta_t);
+      cost(cte, steer, plant.speed(), delta_t);
+      plant.step(steer, throttle, delta_t);
+    }
+    return cost.value(max_steps);
+  }
+
+  // Runs the same episode as runEpisode() with any steering controller,
+  // called as steering(cte, speed in mph, delta_t).
+  template <typename Steering>
+  double runSteering(const Scenario& scenario, Steering steering) const {
+    const Track& track = *scenario.track;
+    VehicleModel plant = startVehicle<double>(scenario);
+    int segment = -1;
+    EpisodeCost cost(cost_weights);
+    PidController throttle_controller(Gains(0.8, 0, 0), scenario.speed);
+    std::mt19937 random(scenario.seed);
+    std::normal_distribution<double> noise(0, scenario.noise > 0 ? scenario.noise : 1);
+
+    for (int step = 1; step <= max_steps; step++) {
+      double cte = track.cte(plant.x(), plant.y(), segment) + (scenario.noise > 0 ? noise(random) : 0);
+      if (fabs(cte) > max_cte) {
+	return cost.value(step) + 1e6 / step;
+      }
+      double steer = steering(cte, plant.speed(), delta_t);
+      double throttle = throttle_controller(plant.speed(), delta_t);
+      cost(cte, steer, plant.speed(), delta_t);
+      plant.step(steer, throttle, delta_t);
+    }
+    return cost.value(max_steps);
+  }
+
+  // Runs the same episode as runEpisode() for up to W sets of gains at
+  // once, with the controllers stepped together in a PidBank. Lanes that
+  // leave the road keep their score and are no longer stepped.
+  template <int W>
+  void runEpisodes(const Scenario& scenario, const Gains* gains, int count, double* scores) const {
+    const Track& track = *scenario.track;
+    std::vector<VehicleModel> plants(count, startVehicle<double>(scenario));
+    std::vector<EpisodeCost> costs(count, EpisodeCost(cost_weights));
+    PidBank<W> steer_bank(0);
+    PidBank<W> throttle_bank(scenario.speed);
+    int segments[W];
+    bool done[W];
+    double cte[W], speed[W], steer[W], throttle[W];
+    for (int lane = 0; lane < W; lane++) {
+      steer_bank.setGains(lane, lane < count ? gains[lane] : Gains(0, 0, 0));
+      throttle_bank.setGains(lane, Gains(0.8, 0, 0));
+      segments[lane] = -1;
+      done[lane] = lane >= count;
+      cte[lane] = speed[lane] = 0;
+    }
+    std::mt19937 random(scenario.seed);
+    std::normal_distribution<double> noise(0, scenario.noise > 0 ? scenario.noise : 1);
+
+    int active = count;
+    for (int step = 1; step <= max_steps && active > 0; step++) {
+      double sensor_noise = scenario.noise > 0 ? noise(random) : 0;
+      for (int lane = 0; lane < count; lane++) {
+	if (done[lane]) {
+	  continue;
+	}
+	cte[lane] = track.cte(plants[lane].x(), plants[lane].y(), segments[lane]) + sensor_noise;
+	speed[lane] = plants[lane].speed();
+	if (fabs(cte[lane]) > max_cte) {
+	  scores[lane] = costs[lane].value(step) + 1e6 / step;
+	  done[lane] = true;
+	  active--;
+	}
+      }
+
+      steer_bank(cte, delta_t, steer);
+      throttle_bank(speed, delta_t, throttle);
+      for (int lane = 0; lane < count; lane++) {
+	if (!done[lane]) {
+	  costs[lane](cte[lane], steer[lane], speed[lane], delta_t);
+	  plants[lane].step(steer[lane], throttle[lane], delta_t);
+	}
+      }
+    }
+    for (int lane = 0; lane < count; lane++) {
+      if (!done[lane]) {
+	scores[lane] = costs[lane].value(max_steps);
+      }
+    }
+  }
+
+  const std::vector<Scenario>& scenarioList() const { return scenarios; }
+
+  // Combines the per-scenario scores of one set of gains, as evaluate() does.
+  double combine(const std::vector<double>& scores) const {
+    return aggregateScores(scores);
+  }
+
+  template <typename T>
+  T evaluate(const BasicGains<T>& gains) const {
+    if (scenarios.empty()) {
+      return 0;
+    }
+
+    std::vector<T> scores(scenarios.size());
+    std::vector<std::thread> workers;
+    size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+    thread_count = std::min(thread_count, scenarios.size());
+
+    for (size_t t = 0; t < thread_count; t++) {
+      workers.push_back(std::thread([this, &scores, &gains, t, thread_count]() {
+	    for (size_t i = t; i < scenarios.size(); i += thread_count) {
+	      scores[i] = runEpisode(scenarios[i], gains);
+	    }
+	  }));
+    }
+    for (auto& worker: workers) {
+      worker.join();
+    }
+    return aggregateScores(scores);
+  }
+
+  double operator()(const Gains& gains) const {
+    return evaluate(gains);
+  }
+
+  // The aggregate score together with its exact gradient with respect to
+  // the gains, computed in one pass with forward-mode differentiation.
+  Dual<3> gradient(const Gains& gains) const;
+};
+
+#endif
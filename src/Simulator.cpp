@@ -0,0 +1,193 @@
+#include "Simulator.hpp"
+
+void WebSocketSink::send(const char* data, size_t length, Protocol protocol) {
+  ws.send(data, length, protocol == Protocol::BINARY ? uWS::OpCode::BINARY : uWS::OpCode::TEXT);
+}
+
+Simulator::Simulator():
+  hub(0, true),
+  next_session(0),
+  coalesce(false), wall_clock(false), skipped(0), malformed(0), stop_requested(false), stopping(false),
+  watchdog_ms(0), watchdog_fires(0) {
+  safe_text_length = TextProtocol::control(SAFE_STEER, SAFE_THROTTLE, safe_text);
+  BinaryFrame safe(BinaryFrame::STEER);
+  safe.steer = SAFE_STEER;
+  safe.throttle = SAFE_THROTTLE;
+  BinaryProtocol::encode(safe, safe_binary);
+
+  hub.onConnection([this](uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
+      Session* session = new Session(next_session++, ws);
+      ws.setUserData(session);
+      sessions.insert(session);
+    });
+
+  hub.onDisconnection([this](uWS::WebSocket<uWS::SERVER> ws, int code, char *message, size_t length) {
+      Session* session = sessionOf(ws);
+      if (session_closed) {
+	session_closed(session->id);
+      }
+      sessions.erase(session);
+      delete session;
+      if (!sessions.empty()) {
+	return;
+      }
+
+      stop();
+      std::cout << "Disconnected" << std::endl;
+      if (coalesce) {
+	std::cout << "Skipped stale frames: " << skipped << std::endl;
+      }
+      if (malformed > 0) {
+	std::cout << "Malformed frames: " << malformed << std::endl;
+      }
+      if (watchdog_fires > 0) {
+	std::cout << "Watchdog stops: " << watchdog_fires << std::endl;
+      }
+    });
+}
+
+Simulator::~Simulator() {
+  for (Session* session: sessions) {
+    delete session;
+  }
+}
+
+void Simulator::onLoopCheck(uv_check_t* handle) {
+  Simulator* self = static_cast<Simulator*>(handle->data);
+  self->processPending();
+}
+
+void Simulator::processPending() {
+  for (Session* session: sessions) {
+    if (session->has_pending) {
+      session->has_pending = false;
+      process_frame(session->pending_ws, session->pending.data(), session->pending.size(), session->pending_op);
+    }
+  }
+  // Not inside the loop: closing the sockets erases from sessions.
+  if (stop_requested) {
+    stop();
+  }
+}
+
+void Simulator::onWatchdogTick(uv_timer_t* handle) {
+  Simulator* self = static_cast<Simulator*>(handle->data);
+  self->checkSessions();
+}
+
+void Simulator::checkSessions() {
+  for (Session* session: sessions) {
+    // Sessions being reset have the car in manual mode.
+    if (session->frames != session->watched_frames || session->frames == 0 || session->step < 0) {
+      session->watched_frames = session->frames;
+      session->silent_ticks = 0;
+      continue;
+    }
+    // Two silent ticks make at least one deadline; the car is stopped once
+    // per silence.
+    if (++session->silent_ticks != 2) {
+      continue;
+    }
+    if (session->protocol == Protocol::BINARY) {
+      session->ws.send(safe_binary, sizeof(safe_binary), uWS::OpCode::BINARY);
+    } else {
+      session->ws.send(safe_text, safe_text_length, uWS::OpCode::TEXT);
+    }
+    watchdog_fires++;
+    std::cerr << "Watchdog: no telemetry from session " << session->id << " for " << watchdog_ms
+	      << " ms, stopping the car (stops: " << watchdog_fires << ")" << std::endl;
+  }
+}
+
+void Simulator::park(uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length, uWS::OpCode opCode) {
+  Session* session = sessionOf(ws);
+  if (session->has_pending) {
+    Protocol protocol = session->pending_op == uWS::OpCode::BINARY ? Protocol::BINARY : Protocol::TEXT;
+    if (isTelemetryFrame(session->pending.data(), session->pending.size(), protocol)) {
+      skipped++;
+    }
+  }
+  session->pending.assign(data, data + length);
+  session->pending_ws = ws;
+  session->pending_op = opCode;
+  session->has_pending = true;
+}
+
+void Simulator::countMalformed() {
+  malformed++;
+  // Logged on powers of two, so a simulator that keeps sending garbage
+  // can't flood the output.
+  if ((malformed & (malformed - 1)) == 0) {
+    std::cerr << "Malformed frames: " << malformed << std::endl;
+  }
+}
+
+void Simulator::recordFrame(const char* data, size_t length, uWS::OpCode opCode) {
+  if (opCode == uWS::OpCode::BINARY) {
+    static const char digits[] = "0123456789abcdef";
+    record << 'b';
+    for (size_t i = 0; i < length; i++) {
+      record << digits[(uint8_t)data[i] >> 4] << digits[(uint8_t)data[i] & 15];
+    }
+  } else {
+    record.write(data, length);
+  }
+  record << '\n';
+}
+
+void Simulator::listenForFrames() {
+  hub.onMessage([this](uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length, uWS::OpCode opCode) {
+      if (record.is_open()) {
+	recordFrame(data, length, opCode);
+      }
+      if (coalesce) {
+	park(ws, data, length, opCode);
+      } else {
+	process_frame(ws, data, length, opCode);
+	if (stop_requested) {
+	  stop();
+	}
+      }
+    });
+}
+
+bool Simulator::recordFrames(const std::string& path) {
+  record.open(path.c_str());
+  return record.is_open();
+}
+
+void Simulator::run(int port) {
+  bool listening = hub.listen(port);
+  if (listening) {
+    std::cout << "Listening on port " << port << std::endl;
+  } else {
+    std::cerr << "Unable to listen on port " << port << std::endl;
+    return;
+  }
+  if (coalesce) {
+    uv_check_init(uv_default_loop(), &coalesce_check);
+    coalesce_check.data = this;
+    uv_check_start(&coalesce_check, onLoopCheck);
+    uv_unref((uv_handle_t*)&coalesce_check);
+  }
+  if (watchdog_ms > 0) {
+    uint64_t tick = (watchdog_ms + 1) / 2;
+    uv_timer_init(uv_default_loop(), &watchdog);
+    watchdog.data = this;
+    uv_timer_start(&watchdog, onWatchdogTick, tick, tick);
+    uv_unref((uv_handle_t*)&watchdog);
+  }
+  hub.run();
+}
+
+void Simulator::stop() {
+  if (stopping) {
+    return;
+  }
+  stopping = true;
+  if (watchdog_ms > 0) {
+    uv_timer_stop(&watchdog);
+  }
+  uWS::Group<uWS::SERVER>& group = hub;
+  group.close();
+}
@@ -1,146 +1,219 @@
 #ifndef __SIMULATOR_H
 #define __SIMULATOR_H
 
+#include <chrono>
+#include <fstream>
 #include <iostream>
 #include <math.h>
 #include <time.h>
+#include <functional>
+#include <set>
+#include <vector>
+#include <uv.h>
 #include <uWS/uWS.h>
-#include "json.hpp"
+#include "Protocol.hpp"
+#include "Responder.hpp"
 
 
-// for convenience
-using json = nlohmann::json;
-
-struct Measurement {
-  int step;
-  double delta_t;
-  double cte;
-  double speed;
-  double angle;
-};
-
-class SimulatorResponder {
+class WebSocketSink : public FrameSink {
   uWS::WebSocket<uWS::SERVER>& ws;
-  bool reset_detected;
-  
-  void send(const std::string& msg) {
-    ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
-  }
 
-  void steer(json data) {
-    auto msg = "42[\"steer\"," + data.dump() + "]";
-    send(msg);
-  }
-  
 public:
-  SimulatorResponder(uWS::WebSocket<uWS::SERVER>& ws): ws(ws), reset_detected(false) {}
-
-  void control(double steer_angle, double throttle) {
-    json msgJson;
-    msgJson["steering_angle"] = steer_angle;
-    msgJson["throttle"] = throttle;
-    steer(msgJson);
-  }
-
-  void manual() {
-    std::string msg = "42[\"manual\",{}]";
-    send(msg);
-  }
-
-  void reset() {
-    std::string msg = "42[\"reset\",{}]";
-    send(msg);
-    reset_detected = true;
-  }
+  WebSocketSink(uWS::WebSocket<uWS::SERVER>& ws): ws(ws) {}
 
-  bool wasReset() const { return reset_detected; }
+  void send(const char* data, size_t length, Protocol protocol);
 };
 
 class Simulator {
+  typedef std::function<void(uWS::WebSocket<uWS::SERVER>, char*, size_t, uWS::OpCode)> FrameHandler;
+  typedef std::function<void(int)> SessionHandler;
+
+  // Per-connection state. Each simulator connected to the hub runs its own
+  // episode, so a pool of simulators can evaluate several candidates at once.
+  struct Session {
+    int id;
+    // Time of the previous frame, in s of the free-running clock.
+    double timestamp;
+    long step;
+    double sim_timestamp;
+    bool lockstep;
+
+    // Telemetry the watchdog has seen: frames counts frames worth a reply,
+    // and the watchdog compares it with its count at the previous tick.
+    uWS::WebSocket<uWS::SERVER> ws;
+    Protocol protocol;
+    long frames;
+    long watched_frames;
+    int silent_ticks;
+
+    // Reused from frame to frame: assign keeps the capacity, so parking
+    // allocates only when a frame is larger than any before it.
+    std::vector<char> pending;
+    uWS::WebSocket<uWS::SERVER> pending_ws;
+    uWS::OpCode pending_op;
+    bool has_pending;
+
+    Session(int id, uWS::WebSocket<uWS::SERVER> ws):
+      id(id), timestamp(-1), step(0), sim_timestamp(-1), lockstep(false),
+      ws(ws), protocol(Protocol::TEXT), frames(0), watched_frames(0), silent_ticks(0),
+      pending_ws(ws), pending_op(uWS::OpCode::TEXT), has_pending(false) {}
+  };
+
   uWS::Hub hub;
-  long timestamp;
-  long step;
-
-  std::string getData(std::string s) {
-    auto found_null = s.find("null");
-    auto b1 = s.find_first_of("[");
-    auto b2 = s.find_last_of("]");
-    if (found_null != std::string::npos) {
-      return "";
-    }
-    else if (b1 != std::string::npos && b2 != std::string::npos) {
-      return s.substr(b1, b2 - b1 + 1);
-    }
-    return "";
+  std::set<Session*> sessions;
+  int next_session;
+
+  // Latest-value-wins mode: frames are parked in their session while uWS
+  // drains the sockets, and only the newest one per session is handled once
+  // the loop has finished polling for I/O.
+  bool coalesce;
+  uv_check_t coalesce_check;
+  // Without lockstep, delta_t is the process's CPU time between frames,
+  // which the shipped gains were tuned against, or the wall-clock time when
+  // this is set.
+  bool wall_clock;
+  FrameHandler process_frame;
+  SessionHandler session_closed;
+  long skipped;
+  long malformed;
+  // Set when a handler asks to stop. stop() closes every socket, and uWS
+  // runs the disconnection handler, which deletes the session, at once, so
+  // it is called only once frame handling has returned.
+  bool stop_requested;
+  bool stopping;
+  std::ofstream record;
+
+  // Stops the car of a session whose telemetry stops for longer than the
+  // deadline. The timer ticks twice per deadline and compares frame counts,
+  // so the frame path only bumps a counter.
+  int watchdog_ms;
+  uv_timer_t watchdog;
+  long watchdog_fires;
+  char safe_text[TextProtocol::MAX_CONTROL_SIZE];
+  size_t safe_text_length;
+  char safe_binary[BinaryProtocol::FRAME_SIZE];
+
+  static Session* sessionOf(uWS::WebSocket<uWS::SERVER>& ws) {
+    return static_cast<Session*>(ws.getUserData());
   }
 
-  bool isValidData(char* data, size_t length) const {
-    return length && length > 2 && data[0] == '4' && data[1] == '2';
-  }
-  
+  static void onLoopCheck(uv_check_t* handle);
+  void processPending();
+  static void onWatchdogTick(uv_timer_t* handle);
+  void checkSessions();
+  void park(uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length, uWS::OpCode opCode);
+  // Appends a frame to the recording: text frames as they are, binary
+  // frames as 'b' followed by their bytes in hex, one frame per line.
+  void recordFrame(const char* data, size_t length, uWS::OpCode opCode);
+  // Hands incoming frames to process_frame, or parks them when coalescing.
+  void listenForFrames();
+  // Counts a frame that can't be read; the caller answers it with the
+  // fail-safe command.
+  void countMalformed();
+
 public:
   static const int WARMUP_STEPS = 150;
-  
-  Simulator(): timestamp(-1), step(-1) {
-    hub.onConnection([this](uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
-	step = 0;
-	timestamp = -1;
-      });
-
-    hub.onDisconnection([this](uWS::WebSocket<uWS::SERVER> ws, int code, char *message, size_t length) {
-	uWS::Group<uWS::SERVER>& group = hub;
-	group.close();
-	std::cout << "Disconnected" << std::endl;
-      });
-  }
+
+  // The command sent when telemetry stops: wheels straight, full brake.
+  static constexpr double SAFE_STEER = 0;
+  static constexpr double SAFE_THROTTLE = -1;
+
+  Simulator();
+  ~Simulator();
 
   template <typename EventHandler>
   void onMeasurement(EventHandler& onMeasurement) {
-    hub.onMessage([this, &onMeasurement](uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length, uWS::OpCode opCode) {
-	SimulatorResponder responder(ws);
-	if (step < 0) {
-	  responder.manual();
-	  return;
-	}
-
-	if (isValidData(data, length)) {
-	  auto s = getData(std::string(data).substr(0, length));
-	  if (s != "" && ++step > WARMUP_STEPS) {
-	    auto j = json::parse(s);
-	    std::string event = j[0].get<std::string>();
-	    if (event == "telemetry") {
-	      Measurement m;
-	      m.step = step;
-	      m.cte = std::stod(j[1]["cte"].get<std::string>());
-	      m.speed = std::stod(j[1]["speed"].get<std::string>());
-	      m.angle = std::stod(j[1]["steering_angle"].get<std::string>());
-	      
-	      time_t cur_ts = clock();
-	      m.delta_t = (timestamp < 0) ? 0 : ((float)(cur_ts - timestamp)) / CLOCKS_PER_SEC;
-	      timestamp = cur_ts;
-
-	      onMeasurement(responder, m);
-	      if (responder.wasReset()) {
-		step = -1;
-	      }
-	    }
+    process_frame = [this, &onMeasurement](uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length, uWS::OpCode opCode) {
+      Session& session = *sessionOf(ws);
+      Protocol protocol = opCode == uWS::OpCode::BINARY ? Protocol::BINARY : Protocol::TEXT;
+      WebSocketSink sink(ws);
+      SimulatorResponder responder(sink, protocol);
+      if (session.step < 0) {
+	responder.manual();
+	return;
+      }
+
+      std::string_view payload;
+      BinaryFrame frame;
+      FrameKind kind = classifyFrame(data, length, protocol, payload, frame);
+      if (kind == FrameKind::IGNORED) {
+	return;
+      }
+      if (kind == FrameKind::MALFORMED) {
+	countMalformed();
+	responder.failSafe();
+	return;
+      }
+      session.frames++;
+      session.protocol = protocol;
+      if (kind == FrameKind::EVENT && ++session.step > WARMUP_STEPS) {
+	Measurement m;
+	ParseStatus status = parseMeasurement(payload, frame, protocol, m);
+	if (status == ParseStatus::OK) {
+	  m.step = session.step;
+	  m.session = session.id;
+
+	  if (m.time >= 0) {
+	    // In lockstep the simulated clock drives the controller, which
+	    // makes episodes reproducible regardless of how fast either side runs.
+	    session.lockstep = true;
+	    m.delta_t = (session.sim_timestamp < 0) ? 0 : m.time - session.sim_timestamp;
+	    session.sim_timestamp = m.time;
 	  } else {
-	    responder.manual();
+	    double cur_ts = wall_clock ?
+	      std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count() :
+	      (double)clock() / CLOCKS_PER_SEC;
+	    m.delta_t = (session.timestamp < 0) ? 0 : cur_ts - session.timestamp;
+	    session.timestamp = cur_ts;
 	  }
+
+	  onMeasurement(responder, m);
+	  if (responder.wasReset()) {
+	    session.step = -1;
+	  }
+	  if (responder.wasStopped()) {
+	    stop_requested = true;
+	  }
+	} else if (status == ParseStatus::MALFORMED) {
+	  countMalformed();
+	  responder.failSafe();
+	} else if (session.lockstep) {
+	  // The simulator is waiting for a reply before it advances
+	  responder.manual();
 	}
-      });
+      } else {
+	responder.manual();
+      }
+    };
+
+    listenForFrames();
   }
 
-  void run(int port) {
-    bool listening = hub.listen(port);
-    if (listening) {
-      std::cout << "Listening on port " << port << std::endl;
-    } else {
-      std::cerr << "Unable to listen on port " << port << std::endl;
-      return;
-    }
-    hub.run();
+  // Called with the id of each session whose connection closes, before its
+  // state is dropped.
+  template <typename EventHandler>
+  void onSessionClosed(EventHandler& onSessionClosed) {
+    session_closed = [&onSessionClosed](int session) { onSessionClosed.sessionClosed(session); };
   }
+
+  void coalesceFrames(bool enable) { coalesce = enable; }
+  void useWallClock(bool enable) { wall_clock = enable; }
+
+  // Records every frame received to a file that TelemetryReplay can play
+  // back. Returns false when the file can't be opened.
+  bool recordFrames(const std::string& path);
+
+  long skippedFrames() const { return skipped; }
+  long malformedFrames() const { return malformed; }
+
+  // Sends the safe command to a session that goes deadline_ms without a
+  // frame worth a reply; 0 turns the watchdog off.
+  void setWatchdog(int deadline_ms) { watchdog_ms = deadline_ms; }
+  long watchdogFires() const { return watchdog_fires; }
+
+  void run(int port);
+  // Closes every connection, which lets run return.
+  void stop();
 };
 
 #endif
@@ -0,0 +1,187 @@
+#include "StabilityCheck.hpp"
+
+void StabilityCheck::discretize(const double a[PLANT_ORDER][PLANT_ORDER], const double b[PLANT_ORDER]) {
+  const int n = PLANT_ORDER + 1;
+  double m[n][n] = {};
+  double norm = 0;
+  for (int r = 0; r < PLANT_ORDER; r++) {
+    double row = fabs(b[r]) * delta_t;
+    for (int c = 0; c < PLANT_ORDER; c++) {
+      m[r][c] = a[r][c] * delta_t;
+      row += fabs(m[r][c]);
+    }
+    m[r][PLANT_ORDER] = b[r] * delta_t;
+    norm = fmax(norm, row);
+  }
+  int squarings = norm > 0.5 ? (int)ceil(log2(norm / 0.5)) : 0;
+  double scale = ldexp(1.0, -squarings);
+  for (int r = 0; r < n; r++) {
+    for (int c = 0; c < n; c++) {
+      m[r][c] *= scale;
+    }
+  }
+
+  double result[n][n] = {}, term[n][n] = {}, next[n][n];
+  for (int r = 0; r < n; r++) {
+    result[r][r] = term[r][r] = 1;
+  }
+  for (int k = 1; k <= 12; k++) {
+    multiply(term, m, next);
+    for (int r = 0; r < n; r++) {
+      for (int c = 0; c < n; c++) {
+	term[r][c] = next[r][c] / k;
+	result[r][c] += term[r][c];
+      }
+    }
+  }
+  for (int s = 0; s < squarings; s++) {
+    multiply(result, result, next);
+    for (int r = 0; r < n; r++) {
+      for (int c = 0; c < n; c++) {
+	result[r][c] = next[r][c];
+      }
+    }
+  }
+
+  for (int r = 0; r < PLANT_ORDER; r++) {
+    for (int c = 0; c < PLANT_ORDER; c++) {
+      phi[r][c] = result[r][c];
+    }
+    gamma[r] = result[r][PLANT_ORDER];
+  }
+}
+
+void StabilityCheck::closedLoop(const Gains& gains, double a[MAX_ORDER][MAX_ORDER]) const {
+  for (int r = 0; r < order; r++) {
+    for (int c = 0; c < order; c++) {
+      a[r][c] = 0;
+    }
+  }
+  const int integral = PLANT_ORDER;
+  const int prev_error = PLANT_ORDER + 1;
+  const int commands = PLANT_ORDER + 2;
+
+  // The error is the lateral offset (minus the CTE), so the command is
+  // u = k_e offset + i integral - (d / T) prev_error.
+  double k_e = gains.p + gains.i * delta_t + gains.d / delta_t;
+  double u[MAX_ORDER] = {};
+  u[0] = k_e;
+  u[integral] = gains.i;
+  u[prev_error] = -gains.d / delta_t;
+
+  // Positive commands turn right, against the positive offset.
+  double wheel[MAX_ORDER] = {};
+  if (delay == 0) {
+    for (int c = 0; c < order; c++) wheel[c] = -max_steer * u[c];
+  } else {
+    wheel[commands + delay - 1] = -max_steer;
+  }
+
+  for (int r = 0; r < PLANT_ORDER; r++) {
+    for (int c = 0; c < PLANT_ORDER; c++) {
+      a[r][c] = phi[r][c];
+    }
+    for (int c = 0; c < order; c++) {
+      a[r][c] += gamma[r] * wheel[c];
+    }
+  }
+  a[integral][integral] = 1;
+  a[integral][0] = delta_t;
+  a[prev_error][0] = 1;
+  if (delay > 0) {
+    for (int c = 0; c < order; c++) {
+      a[commands][c] = u[c];
+    }
+    for (int k = 1; k < delay; k++) {
+      a[commands + k][commands + k - 1] = 1;
+    }
+  }
+}
+
+void StabilityCheck::characteristic(const double a[MAX_ORDER][MAX_ORDER], double coefficients[MAX_ORDER + 1]) const {
+  double m[MAX_ORDER][MAX_ORDER] = {}, am[MAX_ORDER][MAX_ORDER];
+  coefficients[order] = 1;
+  for (int k = 1; k <= order; k++) {
+    for (int r = 0; r < order; r++) {
+      m[r][r] += coefficients[order - k + 1];
+    }
+    double trace = 0;
+    for (int r = 0; r < order; r++) {
+      for (int c = 0; c < order; c++) {
+	double sum = 0;
+	for (int j = 0; j < order; j++) {
+	  sum += a[r][j] * m[j][c];
+	}
+	am[r][c] = sum;
+      }
+      trace += am[r][r];
+    }
+    coefficients[order - k] = -trace / k;
+    for (int r = 0; r < order; r++) {
+      for (int c = 0; c < order; c++) {
+	m[r][c] = am[r][c];
+      }
+    }
+  }
+}
+
+bool StabilityCheck::isSchurStable(const double* coefficients, int degree) {
+  double p[MAX_ORDER + 1];
+  for (int k = 0; k <= degree; k++) {
+    p[k] = coefficients[k];
+  }
+  for (int n = degree; n > 0; n--) {
+    if (fabs(p[0]) >= fabs(p[n])) {
+      return false;
+    }
+    double q[MAX_ORDER + 1];
+    double largest = 0;
+    for (int j = 0; j < n; j++) {
+      q[j] = p[n] * p[j + 1] - p[0] * p[n - 1 - j];
+      largest = fmax(largest, fabs(q[j]));
+    }
+    if (largest == 0) {
+      return false;
+    }
+    for (int j = 0; j < n; j++) {
+      p[j] = q[j] / largest;
+    }
+  }
+  return true;
+}
+
+StabilityCheck::StabilityCheck(const VehicleParams& params, double speed_mph, double delta_t, double max_radius):
+  max_steer(params.max_steer), delta_t(delta_t), max_radius(max_radius) {
+  double v = fmax(speed_mph * VehicleModel::MPH, 1.0);
+  double m = params.mass, inertia = params.yaw_inertia;
+  double lf = params.front_axle, lr = params.rear_axle;
+  double cf = params.front_stiffness, cr = params.rear_stiffness;
+
+  // Offset and heading are positive to the left, as in VehicleModel.
+  double a[PLANT_ORDER][PLANT_ORDER] = {
+    { 0, v, 1, 0 },
+    { 0, 0, 0, 1 },
+    { 0, 0, -(cf + cr) / (m * v), (lr * cr - lf * cf) / (m * v) - v },
+    { 0, 0, (lr * cr - lf * cf) / (inertia * v), -(lf * lf * cf + lr * lr * cr) / (inertia * v) },
+  };
+  double b[PLANT_ORDER] = { 0, 0, cf / m, lf * cf / inertia };
+  discretize(a, b);
+
+  delay = (int)round(params.actuator_delay / delta_t);
+  delay = delay < 0 ? 0 : (delay > MAX_DELAY ? MAX_DELAY : delay);
+  order = PLANT_ORDER + 2 + delay;
+}
+
+bool StabilityCheck::isStable(const Gains& gains) const {
+  double a[MAX_ORDER][MAX_ORDER];
+  double coefficients[MAX_ORDER + 1];
+  closedLoop(gains, a);
+  characteristic(a, coefficients);
+  // The roots of p(r z) are those of p divided by r.
+  double power = 1;
+  for (int k = 0; k <= order; k++) {
+    coefficients[k] *= power;
+    power *= max_radius;
+  }
+  return isSchurStable(coefficients, order);
+}
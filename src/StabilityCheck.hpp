@@ -0,0 +1,69 @@
+#ifndef __STABILITY_CHECK_H
+#define __STABILITY_CHECK_H
+
+#include <math.h>
+#include "PidController.hpp"
+#include "VehicleModel.hpp"
+
+// Analytic closed-loop stability check of the steering PID, meant to reject
+// hopeless candidates before they cost an episode. The vehicle model is
+// linearized on a straight road at a constant speed: lateral offset, heading
+// error, lateral velocity and yaw rate, with linear tires and no steering
+// rate limit. It is discretized at the controller period with a zero-order
+// hold, the actuator dead time is rounded to whole periods, and the
+// discrete PID closes the loop exactly as PidController computes it. The
+// candidate is stable when every root of the characteristic polynomial of
+// the closed loop lies inside the unit circle, which the Jury criterion
+// decides without computing the roots.
+class StabilityCheck {
+  static const int PLANT_ORDER = 4;
+  static const int MAX_DELAY = 8;
+  static const int MAX_ORDER = PLANT_ORDER + 2 + MAX_DELAY;
+
+  double phi[PLANT_ORDER][PLANT_ORDER];
+  double gamma[PLANT_ORDER];
+  double max_steer;
+  double delta_t;
+  double max_radius;
+  int delay;
+  int order;
+
+  // Discretizes x' = A x + B u with a zero-order hold, as the exponential
+  // of the augmented matrix [A B; 0 0] T, by scaling and squaring.
+  void discretize(const double a[PLANT_ORDER][PLANT_ORDER], const double b[PLANT_ORDER]);
+
+  template <int N>
+  static void multiply(const double a[N][N], const double b[N][N], double out[N][N]) {
+    for (int r = 0; r < N; r++) {
+      for (int c = 0; c < N; c++) {
+	double sum = 0;
+	for (int k = 0; k < N; k++) {
+	  sum += a[r][k] * b[k][c];
+	}
+	out[r][c] = sum;
+      }
+    }
+  }
+
+  // Closed-loop transition matrix over the state
+  // [plant, integral, previous error, delayed commands (newest first)].
+  void closedLoop(const Gains& gains, double a[MAX_ORDER][MAX_ORDER]) const;
+
+  // Characteristic polynomial by the Faddeev-LeVerrier recursion:
+  // coefficients[k] multiplies z^k, and coefficients[order] is 1.
+  void characteristic(const double a[MAX_ORDER][MAX_ORDER], double coefficients[MAX_ORDER + 1]) const;
+
+public:
+  // Candidates pass when their slowest mode shrinks, or grows by less than
+  // max_radius per period: a slow divergence is not worth rejecting before
+  // an episode, since the nonlinear plant or the speed loop may hold it.
+  StabilityCheck(const VehicleParams& params, double speed_mph, double delta_t, double max_radius = 1.01);
+
+  // Jury's criterion in its recursive (Schur-Cohn) form: the roots of p are
+  // inside the unit circle iff |p_0| < |p_n| and the same holds for the
+  // degree n - 1 polynomial (p_n p(z) - p_0 z^n p(1/z)) / z.
+  static bool isSchurStable(const double* coefficients, int degree);
+  bool isStable(const Gains& gains) const;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include "TelemetryReplay.hpp"
+
+#include <fstream>
+
+int TelemetryReplay::hexDigit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+bool TelemetryReplay::load(const std::string& path) {
+  std::ifstream file(path.c_str());
+  if (!file) {
+    return false;
+  }
+  std::string line, frame;
+  Protocol protocol;
+  while (std::getline(file, line)) {
+    if (!decodeLine(line, frame, protocol)) {
+      return false;
+    }
+    frames.push_back(frame);
+    protocols.push_back(protocol);
+  }
+  return true;
+}
+
+bool TelemetryReplay::decodeLine(std::string_view line, std::string& frame, Protocol& protocol) {
+  if (line.empty() || line[0] != 'b') {
+    frame = line;
+    protocol = Protocol::TEXT;
+    return true;
+  }
+  frame.clear();
+  for (size_t i = 1; i + 1 < line.size(); i += 2) {
+    int high = hexDigit(line[i]), low = hexDigit(line[i + 1]);
+    if (high < 0 || low < 0) {
+      return false;
+    }
+    frame.push_back((char)(high * 16 + low));
+  }
+  protocol = Protocol::BINARY;
+  return true;
+}
+
+void TelemetryReplay::send(const char* data, size_t length, Protocol protocol) {
+  replies++;
+}
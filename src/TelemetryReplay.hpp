@@ -0,0 +1,90 @@
+#ifndef __TELEMETRY_REPLAY_H
+#define __TELEMETRY_REPLAY_H
+
+#include <string>
+#include <vector>
+#include "Protocol.hpp"
+#include "Responder.hpp"
+
+// Plays a recording made with Simulator::recordFrames back to a controller,
+// through the same parsing and reply encoding as the live simulator but
+// without a socket. The controller sees the frames as fast as it can take
+// them, which makes the replay a benchmark of the per-frame path and a
+// training run for profile-guided optimization. Measurements that don't
+// carry a simulated clock are spaced 'period' seconds apart.
+class TelemetryReplay : public FrameSink {
+  std::vector<std::string> frames;
+  std::vector<Protocol> protocols;
+  double period;
+  long replies;
+  long malformed;
+
+  static int hexDigit(char c);
+
+public:
+  TelemetryReplay(double period = 0.05):
+    period(period), replies(0), malformed(0) {}
+
+  // Returns false when the file can't be read or has a malformed binary
+  // frame.
+  bool load(const std::string& path);
+
+  // Decodes one line of a recording: a text frame as it was received, or
+  // 'b' and the bytes of a binary frame in hex.
+  static bool decodeLine(std::string_view line, std::string& frame, Protocol& protocol);
+
+  size_t size() const { return frames.size(); }
+  long replyCount() const { return replies; }
+  long malformedFrames() const { return malformed; }
+
+  void send(const char* data, size_t length, Protocol protocol);
+
+  // Plays the recording 'repeat' times, or until the controller asks to
+  // stop. Frames that can't be read get the fail-safe reply, as they would
+  // from the live simulator. Returns the number of measurements handed to
+  // the controller.
+  template <typename EventHandler>
+  long run(EventHandler& onMeasurement, int repeat = 1) {
+    long measurements = 0;
+    bool stopped = false;
+    for (int pass = 0; pass < repeat && !stopped; pass++) {
+      int step = 0;
+      double sim_timestamp = -1;
+      for (size_t i = 0; i < frames.size() && !stopped; i++) {
+	std::string_view payload;
+	BinaryFrame frame;
+	FrameKind kind = classifyFrame(frames[i].data(), frames[i].size(), protocols[i], payload, frame);
+	Measurement m;
+	ParseStatus status = kind == FrameKind::EVENT ? parseMeasurement(payload, frame, protocols[i], m) :
+	  kind == FrameKind::MALFORMED ? ParseStatus::MALFORMED : ParseStatus::OTHER_EVENT;
+	if (status == ParseStatus::MALFORMED) {
+	  malformed++;
+	  SimulatorResponder(*this, protocols[i]).failSafe();
+	}
+	if (status != ParseStatus::OK) {
+	  continue;
+	}
+	m.step = ++step;
+	m.session = 0;
+	if (m.time >= 0) {
+	  m.delta_t = sim_timestamp < 0 ? 0 : m.time - sim_timestamp;
+	  sim_timestamp = m.time;
+	} else {
+	  m.delta_t = step > 1 ? period : 0;
+	}
+
+	SimulatorResponder responder(*this, protocols[i]);
+	onMeasurement(responder, m);
+	measurements++;
+	if (responder.wasReset()) {
+	  step = 0;
+	  sim_timestamp = -1;
+	}
+	stopped = responder.wasStopped();
+      }
+    }
+    return measurements;
+  }
+};
+
+#endif
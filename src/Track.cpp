@@ -0,0 +1,310 @@
+#include "Track.hpp"
+
+Track::Spline Track::fitSpline(const std::vector<double>& values, const std::vector<double>& t, bool closed) {
+  size_t n = values.size();
+  size_t pieces = closed ? n : n - 1;
+  std::vector<double> h(pieces), slope(pieces);
+  for (size_t i = 0; i < pieces; i++) {
+    h[i] = t[i + 1] - t[i];
+    slope[i] = (values[(i + 1) % n] - values[i]) / h[i];
+  }
+
+  // Second derivatives m[] at the knots, from the tridiagonal system
+  // h[i-1] m[i-1] + 2 (h[i-1] + h[i]) m[i] + h[i] m[i+1] = 6 (slope[i] - slope[i-1]).
+  std::vector<double> m(n, 0.0);
+  if (closed) {
+    // Cyclic system, solved with the Sherman-Morrison correction.
+    std::vector<double> diag(n), upper(n), rhs(n), z(n, 0.0);
+    for (size_t i = 0; i < n; i++) {
+      size_t prev = (i + n - 1) % n;
+      diag[i] = 2 * (h[prev] + h[i]);
+      upper[i] = h[i];
+      rhs[i] = 6 * (slope[i] - slope[prev]);
+    }
+    double corner = h[n - 1];
+    double gamma = -diag[0];
+    diag[0] -= gamma;
+    diag[n - 1] -= corner * corner / gamma;
+    z[0] = gamma;
+    z[n - 1] = corner;
+    solveTridiagonal(upper, diag, rhs, m);
+    std::vector<double> q(n);
+    solveTridiagonal(upper, diag, z, q);
+    double factor = (m[0] + corner * m[n - 1] / gamma) / (1 + q[0] + corner * q[n - 1] / gamma);
+    for (size_t i = 0; i < n; i++) {
+      m[i] -= factor * q[i];
+    }
+  } else if (n > 2) {
+    std::vector<double> diag(n - 2), upper(n - 2), rhs(n - 2), inner(n - 2);
+    for (size_t i = 1; i + 1 < n; i++) {
+      diag[i - 1] = 2 * (h[i - 1] + h[i]);
+      upper[i - 1] = h[i];
+      rhs[i - 1] = 6 * (slope[i] - slope[i - 1]);
+    }
+    solveTridiagonal(upper, diag, rhs, inner);
+    std::copy(inner.begin(), inner.end(), m.begin() + 1);
+  }
+
+  Spline spline;
+  for (size_t i = 0; i < pieces; i++) {
+    double m0 = m[i], m1 = m[(i + 1) % n];
+    spline.a.push_back(values[i]);
+    spline.b.push_back(slope[i] - h[i] * (2 * m0 + m1) / 6);
+    spline.c.push_back(m0 / 2);
+    spline.d.push_back((m1 - m0) / (6 * h[i]));
+  }
+  return spline;
+}
+
+double Track::pieceLength(const Spline& sx, const Spline& sy, size_t i, double u) {
+  static const double nodes[5] = { -0.9061798459, -0.5384693101, 0.0, 0.5384693101, 0.9061798459 };
+  static const double weights[5] = { 0.2369268851, 0.4786286705, 0.5688888889, 0.4786286705, 0.2369268851 };
+  double sum = 0;
+  for (int k = 0; k < 5; k++) {
+    double x, y, dx, dy, ddx, ddy;
+    evaluate(sx, sy, i, u * (nodes[k] + 1) / 2, x, y, dx, dy, ddx, ddy);
+    sum += weights[k] * sqrt(dx * dx + dy * dy);
+  }
+  return sum * u / 2;
+}
+
+void Track::resample(const std::vector<TrackPoint>& waypoints) {
+  size_t n = waypoints.size();
+  size_t pieces = closed ? n : n - 1;
+  std::vector<double> xs(n), ys(n), t(pieces + 1, 0.0);
+  for (size_t i = 0; i < n; i++) {
+    xs[i] = waypoints[i].x;
+    ys[i] = waypoints[i].y;
+  }
+  for (size_t i = 0; i < pieces; i++) {
+    const TrackPoint& a = waypoints[i];
+    const TrackPoint& b = waypoints[(i + 1) % n];
+    t[i + 1] = t[i] + fmax(hypot(b.x - a.x, b.y - a.y), 1e-6);
+  }
+  Spline sx = fitSpline(xs, t, closed);
+  Spline sy = fitSpline(ys, t, closed);
+
+  std::vector<double> piece_start(pieces + 1, 0.0);
+  for (size_t i = 0; i < pieces; i++) {
+    piece_start[i + 1] = piece_start[i] + pieceLength(sx, sy, i, t[i + 1] - t[i]);
+  }
+  length = piece_start[pieces];
+
+  int count = std::max(2, (int)ceil(length / spacing));
+  spacing = length / count;
+  if (!closed) {
+    count++;
+  }
+  samples.resize(count);
+  size_t piece = 0;
+  for (int k = 0; k < count; k++) {
+    double s = k * spacing;
+    while (piece + 1 < pieces && piece_start[piece + 1] <= s) {
+      piece++;
+    }
+    // Newton's method on the arc length within the piece.
+    double h = t[piece + 1] - t[piece];
+    double target = s - piece_start[piece];
+    double u = fmin(h, fmax(0.0, target));
+    double x, y, dx, dy, ddx, ddy;
+    for (int iteration = 0; iteration < 4; iteration++) {
+      evaluate(sx, sy, piece, u, x, y, dx, dy, ddx, ddy);
+      double speed = sqrt(dx * dx + dy * dy);
+      u = fmin(h, fmax(0.0, u - (pieceLength(sx, sy, piece, u) - target) / fmax(speed, 1e-9)));
+    }
+    evaluate(sx, sy, piece, u, x, y, dx, dy, ddx, ddy);
+    double speed = fmax(sqrt(dx * dx + dy * dy), 1e-9);
+    Sample& sample = samples[k];
+    sample.x = x;
+    sample.y = y;
+    sample.s = s;
+    sample.curvature = -(dx * ddy - dy * ddx) / (speed * speed * speed);
+  }
+}
+
+void Track::buildGrid() {
+  double min_x = samples[0].x, max_x = min_x, min_y = samples[0].y, max_y = min_y;
+  for (const Sample& sample: samples) {
+    min_x = fmin(min_x, sample.x);
+    max_x = fmax(max_x, sample.x);
+    min_y = fmin(min_y, sample.y);
+    max_y = fmax(max_y, sample.y);
+  }
+  cell_size = fmax(5.0, sqrt((max_x - min_x) * (max_y - min_y) / 65536));
+  grid_x = min_x - cell_size;
+  grid_y = min_y - cell_size;
+  grid_width = (int)ceil((max_x - grid_x) / cell_size) + 2;
+  grid_height = (int)ceil((max_y - grid_y) / cell_size) + 2;
+
+  std::vector<int> counts(grid_width * grid_height + 1, 0);
+  for (int pass = 0; pass < 2; pass++) {
+    for (int segment = 0; segment < segmentCount(); segment++) {
+      const Sample& a = samples[segment];
+      const Sample& b = samples[nextSample(segment)];
+      int x0 = (int)floor((fmin(a.x, b.x) - grid_x) / cell_size);
+      int x1 = (int)floor((fmax(a.x, b.x) - grid_x) / cell_size);
+      int y0 = (int)floor((fmin(a.y, b.y) - grid_y) / cell_size);
+      int y1 = (int)floor((fmax(a.y, b.y) - grid_y) / cell_size);
+      for (int cy = std::max(0, y0); cy <= std::min(grid_height - 1, y1); cy++) {
+	for (int cx = std::max(0, x0); cx <= std::min(grid_width - 1, x1); cx++) {
+	  int cell = cy * grid_width + cx;
+	  if (pass == 0) {
+	    counts[cell + 1]++;
+	  } else {
+	    cell_segments[counts[cell]++] = segment;
+	  }
+	}
+      }
+    }
+    if (pass == 0) {
+      for (size_t c = 1; c < counts.size(); c++) {
+	counts[c] += counts[c - 1];
+      }
+      cell_start = counts;
+      cell_segments.resize(counts.back());
+    }
+  }
+}
+
+int Track::coldSearch(double x, double y) const {
+  int best = 0;
+  double best_distance = -1;
+  int cx = (int)floor((x - grid_x) / cell_size);
+  int cy = (int)floor((y - grid_y) / cell_size);
+  if (cx >= 0 && cy >= 0 && cx < grid_width && cy < grid_height) {
+    int max_ring = std::max(grid_width, grid_height);
+    for (int ring = 0; ring <= max_ring; ring++) {
+      for (int ny = cy - ring; ny <= cy + ring; ny++) {
+	if (ny < 0 || ny >= grid_height) {
+	  continue;
+	}
+	bool edge_row = ny == cy - ring || ny == cy + ring;
+	for (int nx = cx - ring; nx <= cx + ring; nx += (edge_row || ring == 0) ? 1 : 2 * ring) {
+	  if (nx < 0 || nx >= grid_width) {
+	    continue;
+	  }
+	  int cell = ny * grid_width + nx;
+	  for (int k = cell_start[cell]; k < cell_start[cell + 1]; k++) {
+	    double distance = segmentDistance2(cell_segments[k], x, y);
+	    if (best_distance < 0 || distance < best_distance) {
+	      best_distance = distance;
+	      best = cell_segments[k];
+	    }
+	  }
+	}
+      }
+      double covered = ring * cell_size;
+      if (best_distance >= 0 && best_distance < covered * covered) {
+	return best;
+      }
+    }
+  }
+
+  // Outside the grid: check every segment.
+  for (int segment = 0; segment < segmentCount(); segment++) {
+    double distance = segmentDistance2(segment, x, y);
+    if (best_distance < 0 || distance < best_distance) {
+      best_distance = distance;
+      best = segment;
+    }
+  }
+  return best;
+}
+
+std::vector<TrackPoint> Track::distinctPoints(const std::vector<TrackPoint>& waypoints, bool closed) {
+  std::vector<TrackPoint> points;
+  for (const TrackPoint& point: waypoints) {
+    if (points.empty() || hypot(point.x - points.back().x, point.y - points.back().y) >= 1e-6) {
+      points.push_back(point);
+    }
+  }
+  if (closed && points.size() > 1 &&
+      hypot(points.front().x - points.back().x, points.front().y - points.back().y) < 1e-6) {
+    points.pop_back();
+  }
+  return points;
+}
+
+Track::Track(const std::vector<TrackPoint>& waypoints, bool closed, double spacing):
+  closed(closed), length(0), spacing(spacing) {
+  resample(distinctPoints(waypoints, closed));
+  buildGrid();
+}
+
+bool Track::loadWaypoints(const std::string& path, std::vector<TrackPoint>& waypoints) {
+  std::ifstream file(path.c_str());
+  if (!file) {
+    return false;
+  }
+  std::vector<TrackPoint> result;
+  std::string line;
+  while (std::getline(file, line)) {
+    const char* start = line.c_str();
+    char* end;
+    TrackPoint point;
+    point.x = strtod(start, &end);
+    if (end == start) {
+      continue;
+    }
+    while (*end == ',' || *end == ' ' || *end == '\t') end++;
+    start = end;
+    point.y = strtod(start, &end);
+    if (end == start) {
+      continue;
+    }
+    result.push_back(point);
+  }
+  if (distinctPoints(result, true).size() < minimumPoints(true)) {
+    return false;
+  }
+  waypoints = result;
+  return true;
+}
+
+Track Track::arc(double curvature, double length, double spacing) {
+  const double waypoint_spacing = 5.0;
+  std::vector<TrackPoint> waypoints;
+  bool closed = curvature != 0 && 2 * M_PI / fabs(curvature) <= length;
+  if (closed) {
+    length = 2 * M_PI / fabs(curvature);
+  }
+  int count = std::max(3, (int)ceil(length / waypoint_spacing));
+  for (int k = 0; k <= count; k++) {
+    double s = length * k / count;
+    TrackPoint point = { s, 0 };
+    if (curvature != 0) {
+      point.x = sin(fabs(curvature) * s) / fabs(curvature);
+      point.y = -(1 - cos(fabs(curvature) * s)) / curvature;
+    }
+    waypoints.push_back(point);
+  }
+  return Track(waypoints, closed, spacing);
+}
+
+TrackProjection Track::project(double x, double y, int hint) const {
+  TrackProjection result;
+  result.segment = nearestSegment(x, y, hint);
+  const Sample& a = samples[result.segment];
+  const Sample& b = samples[nextSample(result.segment)];
+  double ux = b.x - a.x, uy = b.y - a.y;
+  double norm = sqrt(ux * ux + uy * uy);
+  double t = fmin(1.0, fmax(0.0, ((x - a.x) * ux + (y - a.y) * uy) / (norm * norm)));
+  result.s = a.s + t * norm;
+  result.cte = ((x - a.x) * uy - (y - a.y) * ux) / norm;
+  result.heading = atan2(uy, ux);
+  result.curvature = a.curvature + t * (b.curvature - a.curvature);
+  return result;
+}
+
+void Track::pose(double s, double& x, double& y, double& heading) const {
+  if (closed) {
+    s = fmod(fmod(s, length) + length, length);
+  }
+  int segment = std::min(segmentCount() - 1, std::max(0, (int)(s / spacing)));
+  const Sample& a = samples[segment];
+  const Sample& b = samples[nextSample(segment)];
+  double t = fmin(1.0, fmax(0.0, (s - a.s) / spacing));
+  x = a.x + t * (b.x - a.x);
+  y = a.y + t * (b.y - a.y);
+  heading = atan2(b.y - a.y, b.x - a.x);
+}
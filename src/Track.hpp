@@ -0,0 +1,201 @@
+#ifndef __TRACK_H
+#define __TRACK_H
+
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "Dual.hpp"
+
+struct TrackPoint {
+  double x;
+  double y;
+};
+
+struct TrackProjection {
+  int segment;
+  // Distance along the center line, in m.
+  double s;
+  // Cross track error, positive to the right of the center line.
+  double cte;
+  double heading;
+  // Curvature of the center line in 1/m, positive when it turns right.
+  double curvature;
+};
+
+// Center line of a track: a cubic spline through the waypoints, resampled at
+// a fixed arc-length spacing into a dense polyline. Nearest point queries
+// walk from the segment found on the previous query, which costs O(1) when
+// the car moves by a few samples between queries; cold starts go through a
+// uniform grid of the segments.
+class Track {
+  struct Sample {
+    double x, y;
+    double s;
+    double curvature;
+  };
+
+  std::vector<Sample> samples;
+  bool closed;
+  double length;
+  double spacing;
+
+  double grid_x, grid_y;
+  double cell_size;
+  int grid_width, grid_height;
+  // Segments overlapping each cell, in compressed row form: the segments of
+  // cell c are cell_segments[cell_start[c] .. cell_start[c + 1]).
+  std::vector<int> cell_start;
+  std::vector<int> cell_segments;
+
+  // Longest walk a warm-started query takes before falling back to the grid.
+  static const int MAX_WALK = 64;
+
+  struct Spline {
+    std::vector<double> a, b, c, d;
+  };
+
+  // Coefficients of the cubic spline through values[] at parameters t[],
+  // with natural ends, or periodic when closed (values[] then doesn't repeat
+  // the first point, and t[] has one more entry for the closing knot).
+  static Spline fitSpline(const std::vector<double>& values, const std::vector<double>& t, bool closed);
+
+  // Symmetric tridiagonal solve (Thomas algorithm); upper[i] couples rows i
+  // and i + 1.
+  static void solveTridiagonal(const std::vector<double>& upper, std::vector<double> diag,
+			       std::vector<double> rhs, std::vector<double>& x) {
+    size_t n = diag.size();
+    for (size_t i = 1; i < n; i++) {
+      double w = upper[i - 1] / diag[i - 1];
+      diag[i] -= w * upper[i - 1];
+      rhs[i] -= w * rhs[i - 1];
+    }
+    x.resize(n);
+    x[n - 1] = rhs[n - 1] / diag[n - 1];
+    for (size_t i = n - 1; i-- > 0;) {
+      x[i] = (rhs[i] - upper[i] * x[i + 1]) / diag[i];
+    }
+  }
+
+  static void evaluate(const Spline& sx, const Spline& sy, size_t i, double u,
+		       double& x, double& y, double& dx, double& dy, double& ddx, double& ddy) {
+    x = sx.a[i] + u * (sx.b[i] + u * (sx.c[i] + u * sx.d[i]));
+    y = sy.a[i] + u * (sy.b[i] + u * (sy.c[i] + u * sy.d[i]));
+    dx = sx.b[i] + u * (2 * sx.c[i] + u * 3 * sx.d[i]);
+    dy = sy.b[i] + u * (2 * sy.c[i] + u * 3 * sy.d[i]);
+    ddx = 2 * sx.c[i] + 6 * sx.d[i] * u;
+    ddy = 2 * sy.c[i] + 6 * sy.d[i] * u;
+  }
+
+  // The waypoints without repeats: a point equal to the one before it, or
+  // on a closed track a last point equal to the first, would make a piece
+  // of zero length.
+  static std::vector<TrackPoint> distinctPoints(const std::vector<TrackPoint>& waypoints, bool closed);
+
+  // Arc length of spline piece i from 0 to u, by 5-point Gauss-Legendre.
+  static double pieceLength(const Spline& sx, const Spline& sy, size_t i, double u);
+  void resample(const std::vector<TrackPoint>& waypoints);
+
+  int segmentCount() const { return closed ? (int)samples.size() : (int)samples.size() - 1; }
+  int nextSample(int i) const { return i + 1 == (int)samples.size() ? 0 : i + 1; }
+
+  double segmentDistance2(int segment, double x, double y) const {
+    const Sample& a = samples[segment];
+    const Sample& b = samples[nextSample(segment)];
+    double ux = b.x - a.x, uy = b.y - a.y;
+    double t = ((x - a.x) * ux + (y - a.y) * uy) / (ux * ux + uy * uy);
+    t = fmin(1.0, fmax(0.0, t));
+    double ex = x - a.x - t * ux, ey = y - a.y - t * uy;
+    return ex * ex + ey * ey;
+  }
+
+  // Every segment goes into the cells overlapped by its bounding box.
+  void buildGrid();
+
+  // Searches rings of cells around the one containing (x, y). A segment at
+  // distance D is listed in a cell at most floor(D / cell_size) + 1 rings
+  // away, so the search can stop once the best distance is within the rings
+  // covered so far.
+  int coldSearch(double x, double y) const;
+
+  int warmSearch(double x, double y, int hint) const {
+    int count = segmentCount();
+    double distance = segmentDistance2(hint, x, y);
+    for (int direction = 1; direction >= -1; direction -= 2) {
+      for (int walked = 0; ; walked++) {
+	int next = hint + direction;
+	if (closed) {
+	  next = (next + count) % count;
+	} else if (next < 0 || next >= count) {
+	  break;
+	}
+	double next_distance = segmentDistance2(next, x, y);
+	if (next_distance >= distance) {
+	  break;
+	}
+	if (walked == MAX_WALK) {
+	  return -1;
+	}
+	hint = next;
+	distance = next_distance;
+      }
+    }
+    return hint;
+  }
+
+public:
+  // Builds the center line through the waypoints, resampled every
+  // 'spacing' meters. A closed track joins the last waypoint to the first.
+  // There must be at least minimumPoints(closed) distinct waypoints.
+  Track(const std::vector<TrackPoint>& waypoints, bool closed = true, double spacing = 0.5);
+
+  static size_t minimumPoints(bool closed) { return closed ? 3 : 2; }
+
+  // Reads waypoints from a file with one "x,y" (or "x y") pair per line;
+  // lines that don't start with a number, such as a header, are skipped.
+  // Returns false when the file can't be read or has too few distinct
+  // points for a closed track.
+  static bool loadWaypoints(const std::string& path, std::vector<TrackPoint>& waypoints);
+
+  // A road of constant curvature (positive when it turns right) that starts
+  // at the origin heading along x. Curvatures tight enough to close the
+  // circle within 'length' make a closed track.
+  static Track arc(double curvature, double length, double spacing = 0.5);
+
+  double totalLength() const { return length; }
+  bool isClosed() const { return closed; }
+
+  // Segment nearest to (x, y), searched from 'hint' (the result of the
+  // previous query for the same car), or from scratch when hint < 0.
+  int nearestSegment(double x, double y, int hint = -1) const {
+    if (hint >= 0 && hint < segmentCount()) {
+      int segment = warmSearch(x, y, hint);
+      if (segment >= 0) {
+	return segment;
+      }
+    }
+    return coldSearch(x, y);
+  }
+
+  TrackProjection project(double x, double y, int hint = -1) const;
+
+  // Cross track error of (x, y), positive to the right of the center line,
+  // updating 'segment' for the next query. Templated on the scalar type so
+  // that episodes can be differentiated.
+  template <typename T>
+  T cte(const T& x, const T& y, int& segment) const {
+    segment = nearestSegment(value(x), value(y), segment);
+    const Sample& a = samples[segment];
+    const Sample& b = samples[nextSample(segment)];
+    double ux = b.x - a.x, uy = b.y - a.y;
+    double inv_norm = 1.0 / sqrt(ux * ux + uy * uy);
+    return ((x - a.x) * uy - (y - a.y) * ux) * inv_norm;
+  }
+
+  // Position and heading of the center line at distance 's' from the start.
+  void pose(double s, double& x, double& y, double& heading) const;
+};
+
+#endif
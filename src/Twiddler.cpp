@@ -0,0 +1,49 @@
+#include "Twiddler.hpp"
+
+void TwiddleStep::tryNextGain() {
+  do  {
+    current_gain = (current_gain + 1) % 3;      
+  } while (increments[current_gain] == 0);
+
+  gain_iteration = 0;
+  if (current_gain == 0) {
+    _epoch++;
+  }
+}
+
+void TwiddleStep::updateGain() {
+  if (gain_iteration == 0) {
+    gains[current_gain] += increments[current_gain];
+    gain_iteration++;
+  } else if (gain_iteration == 1) {
+    gains[current_gain] -= 2 * increments[current_gain];
+    gain_iteration++;
+  } else {
+    gains[current_gain] += increments[current_gain];
+    increments[current_gain] *= 0.9;
+
+    tryNextGain();
+    updateGain();
+  }
+}
+
+void TwiddleStep::next(double error) {
+  if (isInitialIteration()) {
+    best_error = error;
+  } else if (improvedError(error)) {
+    best_error = error;
+    best_result = gains;
+    increments[current_gain] *= 1.1;
+    tryNextGain();
+  }
+  updateGain();
+}
+
+void TwiddleStep::reject() {
+  updateGain();
+}
+
+void reportSearchState(const TwiddleStep& twiddle_step) {
+  const Gains& increment = twiddle_step.incr();
+  cout << "Increment: [" << increment.p << ", " << increment.i << ", " << increment.d << "]" << endl;
+}
@@ -1,6 +1,14 @@
 #ifndef __TWIDDLER_H
 #define __TWIDDLER_H
 
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include "EpisodeCost.hpp"
+#include "PidController.hpp"
+#include "Responder.hpp"
+#include "StabilityCheck.hpp"
+
 using namespace std;
 
 class TwiddleStep {
@@ -17,38 +25,14 @@ class TwiddleStep {
   bool isInitialIteration() const { return best_error < 0;}
   bool improvedError(double error) const { return error < best_error; }
   
-  void tryNextGain() {
-    do  {
-      current_gain = (current_gain + 1) % 3;      
-    } while (increments[current_gain] == 0);
-
-    gain_iteration = 0;
-    if (current_gain == 0) {
-      _epoch++;
-    }
-  }
-
-  void updateGain() {
-    if (gain_iteration == 0) {
-      gains[current_gain] += increments[current_gain];
-      gain_iteration++;
-    } else if (gain_iteration == 1) {
-      gains[current_gain] -= 2 * increments[current_gain];
-      gain_iteration++;
-    } else {
-      gains[current_gain] += increments[current_gain];
-      increments[current_gain] *= 0.9;
-
-      tryNextGain();
-      updateGain();
-    }
-  }
+  void tryNextGain();
+  void updateGain();
   
 public:
   TwiddleStep(const Gains& init, const Gains& increments):
     best_result(init), best_error(-1),
     gains(init), increments(increments),
-    current_gain(0), gain_iteration(0) {}
+    current_gain(0), gain_iteration(0), _epoch(0) {}
   
   const Gains& current() const { return gains; }
   const Gains& bestResult() const { return best_result; }
@@ -58,83 +42,137 @@ public:
   double bestError() const { return best_error; }
   int epoch() const { return _epoch; }
   
-  void next(double error) {
-    if (isInitialIteration()) {
-      best_error = error;
-    } else if (improvedError(error)) {
-      best_error = error;
-      best_result = gains;
-      increments[current_gain] *= 1.1;
-      tryNextGain();
-    }
-    updateGain();
-  }
+  void next(double error);
+  // Moves past the current candidate without an error, as a probe that
+  // doesn't improve. The initial gains must have been scored.
+  void reject();
 };
 
+void reportSearchState(const TwiddleStep& twiddle_step);
+
+// The reporting and the Twiddler drivers below work with any search step
+// that offers TwiddleStep's interface (current, next, reject, hasFinished,
+// ...), such as BayesianStep.
+template <typename Step>
+void reportCurrentResult(const Step& twiddle_step, double current_error) {
+  const Gains& gains = twiddle_step.current();
+
+  cout << "Epoch: " << twiddle_step.epoch() << endl;
+  cout << "Current error: " << current_error << endl;
+  cout << "Current gain values: [" << gains.p << ", " << gains.i << ", " << gains.d << "]" << endl;
+  reportSearchState(twiddle_step);
+  const Gains& best = twiddle_step.bestResult();
+  cout << "Best result before this: [" << best.p << ", " << best.i << ", " << best.d << "]" << endl;
+  cout << "Best error before this: " << twiddle_step.bestError() << endl << endl;
+}
+
+template <typename Step>
+void reportNextRound(const Step& twiddle_step) {
+  const Gains& gains = twiddle_step.current();
+  cout << endl << "Next values to try: [" << gains.p << ", " << gains.i << ", " << gains.d << "]" << endl;
+}
+
+// Rejects every candidate the stability check fails, without an error, until
+// the step proposes one worth an episode or runs out of candidates.
+template <typename Step>
+void skipUnstable(Step& twiddle_step, const StabilityCheck* prefilter) {
+  while (prefilter && !twiddle_step.hasFinished() && !prefilter->isStable(twiddle_step.current())) {
+    const Gains& gains = twiddle_step.current();
+    cout << "Skipping unstable gains: [" << gains.p << ", " << gains.i << ", " << gains.d << "]" << endl;
+    twiddle_step.reject();
+  }
+}
+
+// The initial gains are the baseline every candidate is compared with, so
+// they get their episode even when they fail the check.
+template <typename Step>
+void checkInitialGains(const Step& twiddle_step, const StabilityCheck& check) {
+  if (!check.isStable(twiddle_step.current())) {
+    const Gains& gains = twiddle_step.current();
+    cout << "Initial gains fail the stability check, running them anyway: ["
+	 << gains.p << ", " << gains.i << ", " << gains.d << "]" << endl;
+  }
+}
+
+template <typename Step = TwiddleStep>
 class Twiddler {
   PidController throttle_controller;
   PidController steer_controller;
-  TwiddleStep twiddle_step;
+  CostWeights cost_weights;
+  EpisodeCost cost;
+  Step twiddle_step;
+  const StabilityCheck* prefilter;
   int max_steps;
   double max_cte;
 
   void cteOverflow(SimulatorResponder& responder, int step) {
-    double overflownError = (steer_controller.squaredSumError() + 1e6) / step;
+    double overflownError = cost.value(step) + 1e6 / step;
     nextTwiddleRound(responder, overflownError);
   }
 
   void nextIteration(SimulatorResponder& responder, int step) {
-    double error = steer_controller.squaredSumError() / step;
+    double error = cost.value(step);
     nextTwiddleRound(responder, error);
   }
 
   void normalOperation(SimulatorResponder& responder, const Measurement& m) {
     double steer_angle = steer_controller(m.cte, m.delta_t);
     double throttle = throttle_controller(m.speed, m.delta_t);
+    cost(m.cte, steer_angle, m.speed, m.delta_t);
     responder.control(steer_angle, throttle);
   }
 
-  void reportCurrentResult(double current_error) {
-    const Gains& gains = twiddle_step.current();
-    const Gains& increment = twiddle_step.incr();
-
-    cout << "Epoch: " << twiddle_step.epoch() << endl;
-    cout << "Current error: " << current_error << endl;
-    cout << "Current gain values: [" << gains.p << ", " << gains.i << ", " << gains.d << "]" << endl;
-    cout << "Increment: [" << increment.p << ", " << increment.i << ", " << increment.d << "]" << endl;
-
-    const Gains& best = twiddle_step.bestResult();
-    cout << "Best result before this: [" << best.p << ", " << best.i << ", " << best.d << "]" << endl;
-    cout << "Best error before this: " << twiddle_step.bestError() << endl << endl;
-  }
-
-  void reportNextRound() {
-    const Gains& gains = twiddle_step.current();
-    cout << endl << "Next values to try: [" << gains.p << ", " << gains.i << ", " << gains.d << "]" << endl;
-  }
-
   void nextTwiddleRound(SimulatorResponder& responder, double error) {
     if (twiddle_step.hasFinished()) {
-      exit(0);
+      responder.stop();
+      return;
     }
 
-    reportCurrentResult(error);
+    reportCurrentResult(twiddle_step, error);
     
     twiddle_step.next(error);
-    reportNextRound();
+    skipUnstable(twiddle_step, prefilter);
+    if (twiddle_step.hasFinished()) {
+      responder.stop();
+      return;
+    }
+    reportNextRound(twiddle_step);
     
     steer_controller = PidController(twiddle_step.current(), 0);
+    cost = EpisodeCost(cost_weights);
     responder.reset();
   }
   
 public:
-  Twiddler(int max_steps, double max_cte, double speed, const Gains& init_gains, const Gains& increment):
+  Twiddler(int max_steps, double max_cte, double speed, const Gains& init_gains, const Gains& increment,
+	   const CostWeights& cost_weights = CostWeights()):
     throttle_controller(Gains(0.8, 0, 0), speed),
-    twiddle_step(TwiddleStep(init_gains, increment)),
+    cost_weights(cost_weights),
+    cost(cost_weights),
+    twiddle_step(Step(init_gains, increment)),
+    prefilter(nullptr),
     max_steps(max_steps),
     max_cte(max_cte) {
     steer_controller = PidController(twiddle_step.current(), 0);
   }
+
+  Twiddler(int max_steps, double max_cte, double speed, const Step& step,
+	   const CostWeights& cost_weights = CostWeights()):
+    throttle_controller(Gains(0.8, 0, 0), speed),
+    cost_weights(cost_weights),
+    cost(cost_weights),
+    twiddle_step(step),
+    prefilter(nullptr),
+    max_steps(max_steps),
+    max_cte(max_cte) {
+    steer_controller = PidController(twiddle_step.current(), 0);
+  }
+
+  // Rejects candidates that fail the check without running their episode.
+  void setPrefilter(const StabilityCheck& check) {
+    prefilter = &check;
+    checkInitialGains(twiddle_step, check);
+  }
   
   void operator()(SimulatorResponder& responder, const Measurement& m) {
     if (m.step < max_steps) {
@@ -149,4 +187,44 @@ public:
   }
 };
 
+// Runs twiddle against an offline evaluator (any callable mapping Gains to
+// an error), such as a ScenarioSuite, instead of the live simulator.
+template <typename Evaluator, typename Step = TwiddleStep>
+class OfflineTwiddler {
+  Step twiddle_step;
+  const Evaluator& evaluate;
+  const StabilityCheck* prefilter;
+
+public:
+  OfflineTwiddler(const Evaluator& evaluate, const Gains& init_gains, const Gains& increment):
+    twiddle_step(init_gains, increment),
+    evaluate(evaluate),
+    prefilter(nullptr) {}
+
+  OfflineTwiddler(const Evaluator& evaluate, const Step& step):
+    twiddle_step(step),
+    evaluate(evaluate),
+    prefilter(nullptr) {}
+
+  void setPrefilter(const StabilityCheck& check) { prefilter = &check; }
+
+  Gains run() {
+    if (prefilter) {
+      checkInitialGains(twiddle_step, *prefilter);
+    }
+    double error = evaluate(twiddle_step.current());
+    while (!twiddle_step.hasFinished()) {
+      reportCurrentResult(twiddle_step, error);
+      twiddle_step.next(error);
+      skipUnstable(twiddle_step, prefilter);
+      if (twiddle_step.hasFinished()) {
+	break;
+      }
+      reportNextRound(twiddle_step);
+      error = evaluate(twiddle_step.current());
+    }
+    return twiddle_step.bestResult();
+  }
+};
+
 #endif
@@ -0,0 +1,220 @@
+#ifndef __VEHICLE_MODEL_H
+#define __VEHICLE_MODEL_H
+
+#include <array>
+#include <math.h>
+
+struct VehicleParams {
+  double mass;
+  double yaw_inertia;
+  // Distances from the center of gravity to the front and rear axles, in m.
+  double front_axle;
+  double rear_axle;
+  // Tire cornering stiffness, in N/rad, and the friction coefficient that
+  // limits the lateral tire force.
+  double front_stiffness;
+  double rear_stiffness;
+  double friction;
+  double max_steer;
+  // Fastest the wheels can turn, in rad/s.
+  double max_steer_rate;
+  double max_accel;
+  double drag;
+  // Dead time between a command and its effect on the actuators, in s.
+  double actuator_delay;
+  // Fixed integration timestep, in s. Every call to step() is split into
+  // as many substeps as needed to cover its period.
+  double substep;
+  bool rk4;
+
+  VehicleParams():
+    mass(1500), yaw_inertia(2250),
+    front_axle(1.2), rear_axle(1.47),
+    front_stiffness(80000), rear_stiffness(80000), friction(1.0),
+    max_steer(25.0 * M_PI / 180.0), max_steer_rate(2.0),
+    max_accel(5.0), drag(0.05),
+    actuator_delay(0.05), substep(0.005), rk4(false) {}
+};
+
+// Dynamic bicycle model with linear tires saturated at the friction limit,
+// yaw inertia, a dead-time actuator delay and a steering rate limit. It is
+// integrated at a fixed substep with semi-implicit Euler (or RK4, about
+// three times slower), and steps without allocating. Positions are in a
+// global frame with x forward and y to the left at the start; positive
+// steering commands turn right, as in the simulator.
+template <typename T>
+class BasicVehicleModel {
+  // The heading is kept as a unit vector rather than an angle, which
+  // keeps trigonometry out of the integrator.
+  struct State {
+    T x, y, heading_cos, heading_sin;
+    T vx, vy, yaw_rate;
+  };
+
+  struct Command {
+    T steer;
+    T throttle;
+  };
+
+  // A power of two, so that the ring buffer wraps with a mask.
+  static const int MAX_DELAY = 64;
+
+  VehicleParams params;
+  double max_force_front;
+  double max_force_rear;
+  State state;
+  T wheel_angle;
+  T distance;
+  T wind;
+
+  std::array<Command, MAX_DELAY> commands;
+  int delay;
+  int head;
+
+  static T clamp(T value, double limit) {
+    return fmax(T(-limit), fmin(T(limit), value));
+  }
+
+  // The wheel angle is constant over a substep, so its cosine is computed
+  // once by the caller.
+  State derivative(const State& s, const T& delta, const T& cos_delta, const T& accel) const {
+    T inv_vx = 1.0 / fmax(s.vx, T(1.0));
+    T slip_front = delta - (s.vy + params.front_axle * s.yaw_rate) * inv_vx;
+    T slip_rear = (params.rear_axle * s.yaw_rate - s.vy) * inv_vx;
+    T force_front = clamp(params.front_stiffness * slip_front, max_force_front);
+    T force_rear = clamp(params.rear_stiffness * slip_rear, max_force_rear);
+
+    State d;
+    d.x = s.vx * s.heading_cos - s.vy * s.heading_sin;
+    d.y = s.vx * s.heading_sin + s.vy * s.heading_cos;
+    d.heading_cos = -s.heading_sin * s.yaw_rate;
+    d.heading_sin = s.heading_cos * s.yaw_rate;
+    d.vx = accel - params.drag * s.vx + s.vy * s.yaw_rate;
+    d.vy = (force_front * cos_delta + force_rear) / params.mass - s.vx * s.yaw_rate + wind;
+    d.yaw_rate = (params.front_axle * force_front * cos_delta - params.rear_axle * force_rear) / params.yaw_inertia;
+    return d;
+  }
+
+  static State advance(const State& s, const State& d, double dt) {
+    State result;
+    result.x = s.x + d.x * dt;
+    result.y = s.y + d.y * dt;
+    result.heading_cos = s.heading_cos + d.heading_cos * dt;
+    result.heading_sin = s.heading_sin + d.heading_sin * dt;
+    result.vx = s.vx + d.vx * dt;
+    result.vy = s.vy + d.vy * dt;
+    result.yaw_rate = s.yaw_rate + d.yaw_rate * dt;
+    return result;
+  }
+
+  void integrate(const T& delta, const T& accel, double dt) {
+    // Wheel angles stay below half a radian, where the Taylor series is
+    // accurate to 1e-5 and much cheaper than cos().
+    T delta2 = delta * delta;
+    T cos_delta = 1 - delta2 * (0.5 - delta2 * (1.0 / 24));
+    if (params.rk4) {
+      State k1 = derivative(state, delta, cos_delta, accel);
+      State k2 = derivative(advance(state, k1, dt / 2), delta, cos_delta, accel);
+      State k3 = derivative(advance(state, k2, dt / 2), delta, cos_delta, accel);
+      State k4 = derivative(advance(state, k3, dt), delta, cos_delta, accel);
+      State sum;
+      sum.x = k1.x + 2 * k2.x + 2 * k3.x + k4.x;
+      sum.y = k1.y + 2 * k2.y + 2 * k3.y + k4.y;
+      sum.heading_cos = k1.heading_cos + 2 * k2.heading_cos + 2 * k3.heading_cos + k4.heading_cos;
+      sum.heading_sin = k1.heading_sin + 2 * k2.heading_sin + 2 * k3.heading_sin + k4.heading_sin;
+      sum.vx = k1.vx + 2 * k2.vx + 2 * k3.vx + k4.vx;
+      sum.vy = k1.vy + 2 * k2.vy + 2 * k3.vy + k4.vy;
+      sum.yaw_rate = k1.yaw_rate + 2 * k2.yaw_rate + 2 * k3.yaw_rate + k4.yaw_rate;
+      state = advance(state, sum, dt / 6);
+    } else {
+      // Semi-implicit Euler: velocities first, then positions from the new
+      // velocities.
+      State d = derivative(state, delta, cos_delta, accel);
+      state.vx += d.vx * dt;
+      state.vy += d.vy * dt;
+      state.yaw_rate += d.yaw_rate * dt;
+      T heading_cos = state.heading_cos - state.heading_sin * state.yaw_rate * dt;
+      T heading_sin = state.heading_sin + state.heading_cos * state.yaw_rate * dt;
+      state.heading_cos = heading_cos;
+      state.heading_sin = heading_sin;
+      state.x += (state.vx * state.heading_cos - state.vy * state.heading_sin) * dt;
+      state.y += (state.vx * state.heading_sin + state.vy * state.heading_cos) * dt;
+    }
+    state.vx = fmax(state.vx, T(0.0));
+
+    T norm = 1.0 / sqrt(state.heading_cos * state.heading_cos + state.heading_sin * state.heading_sin);
+    state.heading_cos *= norm;
+    state.heading_sin *= norm;
+  }
+
+  void substep(const Command& command, double dt) {
+    commands[head] = command;
+    const Command& applied = commands[(head - delay) & (MAX_DELAY - 1)];
+    head = (head + 1) & (MAX_DELAY - 1);
+
+    T target = -clamp(applied.steer, 1.0) * params.max_steer;
+    double max_change = params.max_steer_rate * dt;
+    wheel_angle += clamp(target - wheel_angle, max_change);
+    T accel = clamp(applied.throttle, 1.0) * params.max_accel;
+
+    T speed_before = state.vx;
+    integrate(wheel_angle, accel, dt);
+    distance += (speed_before + state.vx) * (dt / 2);
+  }
+
+public:
+  static constexpr double MPH = 0.44704;
+
+  BasicVehicleModel(const VehicleParams& params, double x, double y, double yaw, double speed_mph):
+    params(params),
+    wheel_angle(0), distance(0), wind(0),
+    delay(0), head(0) {
+    const double gravity = 9.81;
+    double wheelbase = params.front_axle + params.rear_axle;
+    max_force_front = params.friction * params.mass * gravity * params.rear_axle / wheelbase;
+    max_force_rear = params.friction * params.mass * gravity * params.front_axle / wheelbase;
+
+    state.x = x;
+    state.y = y;
+    state.heading_cos = cos(yaw);
+    state.heading_sin = sin(yaw);
+    state.vx = speed_mph * MPH;
+    state.vy = 0;
+    state.yaw_rate = 0;
+
+    delay = (int)round(params.actuator_delay / params.substep);
+    delay = delay < 0 ? 0 : (delay >= MAX_DELAY ? MAX_DELAY - 1 : delay);
+    for (Command& command: commands) {
+      command.steer = 0;
+      command.throttle = 0;
+    }
+  }
+
+  // Side wind, as a lateral acceleration in m/s^2 (positive to the left).
+  void setWind(double value) { wind = value; }
+
+  void step(T steer, T throttle, double dt) {
+    if (dt <= 0) {
+      return;
+    }
+    Command command = { steer, throttle };
+    int count = (int)ceil(dt / params.substep - 1e-9);
+    double h = dt / count;
+    for (int i = 0; i < count; i++) {
+      substep(command, h);
+    }
+  }
+
+  T x() const { return state.x; }
+  T y() const { return state.y; }
+  T yaw() const { return atan2(state.heading_sin, state.heading_cos); }
+  T headingCos() const { return state.heading_cos; }
+  T headingSin() const { return state.heading_sin; }
+  T yawRate() const { return state.yaw_rate; }
+  T speed() const { return state.vx / MPH; }
+  T traveled() const { return distance; }
+};
+
+typedef BasicVehicleModel<double> VehicleModel;
+
+#endif
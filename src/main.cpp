@@ -1,38 +1,423 @@
+#include <chrono>
 #include "PidController.hpp"
 #include "Simulator.hpp"
 #include "Twiddler.hpp"
+#include "ScenarioSuite.hpp"
+#include "GradientTuner.hpp"
+#include "BayesianOptimizer.hpp"
+#include "AsyncTwiddler.hpp"
+#include "GainSweep.hpp"
+#include "RelayAutotune.hpp"
+#include "AdaptivePidController.hpp"
+#include "MpcSteering.hpp"
+#include "OutputShaping.hpp"
+#include "LongitudinalController.hpp"
+#include "ControllerGraph.hpp"
+#include "TelemetryReplay.hpp"
 
 
+// Throttle of the production controller: a P loop on a constant speed,
+// which the steering gains were tuned with.
+class SpeedHold {
+  PidController speed_pid;
+
+public:
+  SpeedHold(double speed): speed_pid(Gains(0.8, 0, 0), speed) {}
+
+  double operator()(const Measurement& m, double) { return speed_pid(m.speed, m.delta_t); }
+};
+
+// Throttle that follows a SpeedProfile and brakes for corners.
+class ProfileSpeed {
+  LongitudinalController controller;
+
+public:
+  ProfileSpeed(const SpeedProfile& profile): controller(profile) {}
+
+  double operator()(const Measurement& m, double steer) { return controller(m.speed, m.cte, steer, m.delta_t); }
+};
+
+// Both outputs are kept within the simulator's range. SteerShaper can add
+// a slew limit to the steering, which keeps a noisy CTE from rattling the
+// wheel, and Throttle may be a ProfileSpeed that slows down for corners.
+template <typename Throttle = SpeedHold, typename SteerShaper = OutputShaper<Clamp>>
 class ProductionCarController {
 public:
-  PidController throttle_controller;
+  Throttle throttle_controller;
   PidController steer_controller;
+  OutputShaper<Clamp> throttle_shaper;
+  SteerShaper steer_shaper;
 
-  ProductionCarController(const Gains& steer_gains, double speed):
-    throttle_controller(Gains(0.8, 0, 0), speed),
-    steer_controller(steer_gains, 0) {}
+  ProductionCarController(const Gains& steer_gains, const Throttle& throttle,
+			  const SteerShaper& steer_shaper = SteerShaper(Clamp())):
+    throttle_controller(throttle),
+    steer_controller(steer_gains, 0),
+    throttle_shaper(Clamp()),
+    steer_shaper(steer_shaper) {}
   
+  void operator()(SimulatorResponder& responder, const Measurement& m) {
+    double steer_angle = steer_shaper(steer_controller(m.cte, m.delta_t), m.delta_t);
+    double throttle = throttle_shaper(throttle_controller(m, steer_angle), m.delta_t);
+    responder.control(steer_angle, throttle);
+  }
+};
+
+typedef OutputShaper<Clamp, SlewRate> SlewedSteering;
+
+
+// Production controller that steers with MpcSteering instead of a PID.
+class MpcCarController {
+public:
+  PidController throttle_controller;
+  MpcSteering<20> steer_controller;
+
+  MpcCarController(double speed):
+    throttle_controller(Gains(0.8, 0, 0), speed) {}
+
+  void operator()(SimulatorResponder& responder, const Measurement& m) {
+    double steer_angle = steer_controller(m.cte, m.speed, m.delta_t);
+    double throttle = throttle_controller(m.speed, m.delta_t);
+    responder.control(steer_angle, throttle);
+  }
+};
+
+
+// Cascaded steering with the speed coupled to it, as a ControllerGraph. The
+// outer loop turns the CTE into a reference for its rate of change, and the
+// inner loop steers so that the rate follows it. The speed reference drops
+// with |cte| and with the steering. The gains are tuned on the in-process
+// plant.
+class CascadedCarController {
+  enum Signal { CTE, SPEED, CTE_RATE, CTE_RATE_REF, STEER, SPEED_REF, THROTTLE };
+
+  ControllerGraph<Rate<CTE_RATE, CTE>,
+		  Pid<CTE_RATE_REF, CTE>,
+		  Pid<STEER, CTE_RATE, CTE_RATE_REF>,
+		  Limit<STEER, STEER>,
+		  SpeedCoupling<SPEED_REF, CTE, STEER>,
+		  Pid<THROTTLE, SPEED, SPEED_REF>,
+		  Feedforward<THROTTLE, SPEED_REF>,
+		  Limit<THROTTLE, THROTTLE>> graph;
+
+public:
+  CascadedCarController(double max_speed):
+    graph(Rate<CTE_RATE, CTE>(0.02),
+	  Pid<CTE_RATE_REF, CTE>(Gains(0.9, 0, 0)),
+	  Pid<STEER, CTE_RATE, CTE_RATE_REF>(Gains(0.07, 0.04, 0)),
+	  Limit<STEER, STEER>(),
+	  SpeedCoupling<SPEED_REF, CTE, STEER>(max_speed, 20, 5, 30),
+	  Pid<THROTTLE, SPEED, SPEED_REF>(Gains(0.1, 0.02, 0)),
+	  Feedforward<THROTTLE, SPEED_REF>(0.0045),
+	  Limit<THROTTLE, THROTTLE>()) {}
+
+  // Steps the whole graph, and returns the steering.
+  double steer(double cte, double speed, double delta_t) {
+    graph[CTE] = cte;
+    graph[SPEED] = speed;
+    graph(delta_t);
+    return graph[STEER];
+  }
+
+  void operator()(SimulatorResponder& responder, const Measurement& m) {
+    double steer_angle = steer(m.cte, m.speed, m.delta_t);
+    responder.control(steer_angle, graph[THROTTLE]);
+  }
+};
+
+
+// Production controller whose steering gains keep adapting to the live
+// telemetry, within half and one and a half times the nominal gains.
+class AdaptiveCarController {
+public:
+  PidController throttle_controller;
+  AdaptivePidController steer_controller;
+  int frames;
+
+  AdaptiveCarController(const Gains& steer_gains, double speed):
+    throttle_controller(Gains(0.8, 0, 0), speed),
+    steer_controller(steer_gains,
+		     Gains(0.5 * steer_gains.p, 0.5 * steer_gains.i, 0.5 * steer_gains.d),
+		     Gains(1.5 * steer_gains.p, 1.5 * steer_gains.i, 1.5 * steer_gains.d),
+		     Gains(0.1 * steer_gains.p, 0.1 * steer_gains.i, 0.1 * steer_gains.d),
+		     0.05, 0),
+    frames(0) {}
+
   void operator()(SimulatorResponder& responder, const Measurement& m) {
     double steer_angle = steer_controller(m.cte, m.delta_t);
     double throttle = throttle_controller(m.speed, m.delta_t);
     responder.control(steer_angle, throttle);
+
+    if (++frames % 500 == 0) {
+      const Gains& gains = steer_controller.currentGains();
+      cout << "Adapted gains: [" << gains.p << ", " << gains.i << ", " << gains.d << "]" << endl;
+    }
   }
 };
 
 
+Aggregate parseAggregate(const string& name) {
+  if (name == "worst") {
+    return Aggregate::WORST;
+  } else if (name == "cvar") {
+    return Aggregate::CVAR;
+  }
+  return Aggregate::MEAN;
+}
+
 int main(int argc, char** argv)
 {
   const int port = 4567;
   Simulator simulator;
-  ProductionCarController production(Gains(0.31, 1.1, 0.01), 30.0);
-  Twiddler twiddle(3500, 3.0, 40.0, Gains(0.2, 1.0, 0.01), Gains(0.1, 0.1, 0.1));
+  AdaptiveCarController adaptive(Gains(0.31, 1.1, 0.01), 30.0);
+  MpcCarController mpc(50.0);
+  CascadedCarController cascade(40.0);
+  ScenarioSuite suite(ScenarioSuite::standardScenarios(), 1000, 3.0, 0.05);
+  CostWeights cost_weights;
+  int sweep_grid = 16;
+  int sweep_samples = 0;
+  string sweep_output = "sweep.csv";
+  bool prefilter = false;
+  TuningRule tuning_rule = TuningRule::TYREUS_LUYBEN;
+  int replay_repeat = 1;
+  double steer_rate = 0;
+  double profile_speed = 0;
+
+  for (int i = 1; i < argc; i++) {
+    string arg(argv[i]);
+    if (arg == "--coalesce") {
+      simulator.coalesceFrames(true);
+    } else if (arg == "--wall-clock") {
+      simulator.useWallClock(true);
+    } else if (arg.compare(0, 12, "--aggregate=") == 0) {
+      suite.setAggregate(parseAggregate(arg.substr(12)));
+    } else if (arg.compare(0, 7, "--cost=") == 0) {
+      if (!CostWeights::parse(arg.substr(7), cost_weights)) {
+	cerr << "Invalid cost specification: " << arg.substr(7) << endl;
+	return 1;
+      }
+      suite.setCostWeights(cost_weights);
+    } else if (arg.compare(0, 8, "--track=") == 0) {
+      std::vector<TrackPoint> waypoints;
+      if (!Track::loadWaypoints(arg.substr(8), waypoints)) {
+	cerr << "Could not load track waypoints, or fewer than " << Track::minimumPoints(true)
+	     << " distinct ones: " << arg.substr(8) << endl;
+	return 1;
+      }
+      suite.setTrack(Track(waypoints));
+    } else if (arg.compare(0, 7, "--grid=") == 0) {
+      sweep_grid = atoi(arg.c_str() + 7);
+    } else if (arg.compare(0, 6, "--lhs=") == 0) {
+      sweep_samples = atoi(arg.c_str() + 6);
+    } else if (arg.compare(0, 6, "--out=") == 0) {
+      sweep_output = arg.substr(6);
+    } else if (arg == "--prefilter") {
+      prefilter = true;
+    } else if (arg.compare(0, 9, "--record=") == 0) {
+      if (!simulator.recordFrames(arg.substr(9))) {
+	cerr << "Could not open " << arg.substr(9) << endl;
+	return 1;
+      }
+    } else if (arg.compare(0, 11, "--watchdog=") == 0) {
+      simulator.setWatchdog(atoi(arg.c_str() + 11));
+    } else if (arg.compare(0, 9, "--repeat=") == 0) {
+      replay_repeat = atoi(arg.c_str() + 9);
+    } else if (arg.compare(0, 13, "--steer-rate=") == 0) {
+      steer_rate = atof(arg.c_str() + 13);
+    } else if (arg.compare(0, 16, "--speed-profile=") == 0) {
+      profile_speed = atof(arg.c_str() + 16);
+    } else if (arg.compare(0, 7, "--rule=") == 0) {
+      if (!parseTuningRule(arg.substr(7), tuning_rule)) {
+	cerr << "Unknown tuning rule: " << arg.substr(7) << endl;
+	return 1;
+      }
+    }
+  }
+  const Gains production_gains(0.31, 1.1, 0.01);
+  SlewedSteering slewed_steering = SlewedSteering(Clamp(), SlewRate(steer_rate));
+  ProductionCarController<> production(production_gains, SpeedHold(30.0));
+  ProductionCarController<SpeedHold, SlewedSteering> slewed_production(production_gains, SpeedHold(30.0), slewed_steering);
+  ProductionCarController<ProfileSpeed> profiled_production(production_gains, SpeedProfile(profile_speed));
+  ProductionCarController<ProfileSpeed, SlewedSteering> profiled_slewed_production(production_gains, SpeedProfile(profile_speed),
+										    slewed_steering);
+  Twiddler<> twiddle(3500, 3.0, 40.0, Gains(0.2, 1.0, 0.01), Gains(0.1, 0.1, 0.1), cost_weights);
+  BayesianStep bayes_step(Gains(0.2, 1.0, 0.01), Gains(0, 0, 0), Gains(1.0, 3.0, 0.5), 40);
+  Twiddler<BayesianStep> bayes(3500, 3.0, 40.0, bayes_step, cost_weights);
+  AsyncTwiddler async_twiddle(3500, 3.0, 40.0, Gains(0.2, 1.0, 0.01), Gains(0.1, 0.1, 0.1), cost_weights);
+  StabilityCheck stability_check(VehicleParams(), 40.0, 0.05);
+  RelayTwiddler autotune(3500, 3.0, 40.0, Gains(0.2, 1.0, 0.01), tuning_rule, cost_weights);
+
+  if ((argc > 1) && (string(argv[1]) == "twiddle-offline")) {
+    cout << "Running offline twiddle on " << ScenarioSuite::standardScenarios().size() << " scenarios" << endl;
+    OfflineTwiddler<ScenarioSuite> offline(suite, Gains(0.1, 0.05, 0.1), Gains(0.05, 0.05, 0.05));
+    if (prefilter) {
+      offline.setPrefilter(stability_check);
+    }
+    Gains best = offline.run();
+    cout << "Best gains: [" << best.p << ", " << best.i << ", " << best.d << "]" << endl;
+    return 0;
+  }
+
+  if ((argc > 1) && (string(argv[1]) == "autotune-offline")) {
+    cout << "Running relay autotune on the vehicle model" << endl;
+    RelayExperiment relay;
+    Gains init(0.1, 0.05, 0.1);
+    if (runRelayOffline(relay, VehicleParams(), 40.0, 0.05, 2000)) {
+      init = relay.gains(tuning_rule);
+      reportRelayResult(relay, init);
+    } else {
+      cout << "No relay limit cycle, twiddling from the default gains" << endl;
+    }
+    OfflineTwiddler<ScenarioSuite> offline(suite, init, seedIncrements(init));
+    if (prefilter) {
+      offline.setPrefilter(stability_check);
+    }
+    Gains best = offline.run();
+    cout << "Best gains: [" << best.p << ", " << best.i << ", " << best.d << "]" << endl;
+    return 0;
+  }
+
+  if ((argc > 1) && (string(argv[1]) == "bayes-offline")) {
+    cout << "Running Bayesian optimization on " << ScenarioSuite::standardScenarios().size() << " scenarios" << endl;
+    OfflineTwiddler<ScenarioSuite, BayesianStep> offline(suite, bayes_step);
+    if (prefilter) {
+      offline.setPrefilter(stability_check);
+    }
+    Gains best = offline.run();
+    cout << "Best gains: [" << best.p << ", " << best.i << ", " << best.d << "]" << endl;
+    return 0;
+  }
+
+  if ((argc > 1) && (string(argv[1]) == "tune-gradient")) {
+    cout << "Running gradient tuning on " << ScenarioSuite::standardScenarios().size() << " scenarios" << endl;
+    GradientTuner<ScenarioSuite> tuner(suite, Gains(0.1, 0.05, 0.1), 0.01, 300);
+    Gains best = tuner.run();
+    cout << "Best gains: [" << best.p << ", " << best.i << ", " << best.d << "]" << endl;
+    cout << "Best error: " << tuner.bestError() << endl;
+    return 0;
+  }
+
+  if ((argc > 1) && (string(argv[1]) == "sweep")) {
+    Gains lower(0, 0, 0), upper(0.5, 0.5, 0.5);
+    std::vector<Gains> candidates = sweep_samples > 0
+      ? GainSweep::latinHypercube(lower, upper, sweep_samples)
+      : GainSweep::grid(lower, upper, sweep_grid);
+    cout << "Sweeping " << candidates.size() << " gains on " << ScenarioSuite::standardScenarios().size() << " scenarios" << endl;
+    GainSweep sweep(suite, candidates);
+    sweep.run();
+    const Gains& best = sweep.candidate(sweep.best());
+    cout << "Best gains: [" << best.p << ", " << best.i << ", " << best.d << "]" << endl;
+    cout << "Best error: " << sweep.cost(sweep.best()) << endl;
+    if (!sweep.write(sweep_output)) {
+      cerr << "Could not write " << sweep_output << endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if ((argc > 2) && (string(argv[1]) == "replay")) {
+    TelemetryReplay replay;
+    if (!replay.load(argv[2])) {
+      cerr << "Could not load telemetry recording: " << argv[2] << endl;
+      return 1;
+    }
+    cout << "Replaying " << replay.size() << " frames " << replay_repeat << " times" << endl;
+    auto start = std::chrono::steady_clock::now();
+    long frames = replay.run(production, replay_repeat);
+    long malformed = replay.malformedFrames();
+    auto middle = std::chrono::steady_clock::now();
+    replay.run(mpc, replay_repeat);
+    auto end = std::chrono::steady_clock::now();
+    if (frames > 0) {
+      cout << "PID: " << std::chrono::duration<double, std::nano>(middle - start).count() / frames << " ns/frame" << endl;
+      cout << "MPC: " << std::chrono::duration<double, std::nano>(end - middle).count() / frames << " ns/frame" << endl;
+    }
+    if (malformed > 0) {
+      cout << "Malformed frames: " << malformed << endl;
+    }
+    return 0;
+  }
+
+  if ((argc > 1) && (string(argv[1]) == "mpc-offline")) {
+    Gains gains(0.095, 0.053, 0.07);
+    cout << "Comparing MPC with PID [" << gains.p << ", " << gains.i << ", " << gains.d << "]" << endl;
+    std::vector<double> pid_scores, mpc_scores;
+    for (const Scenario& scenario: suite.scenarioList()) {
+      MpcSteering<20> steering;
+      pid_scores.push_back(suite.runEpisode(scenario, gains));
+      mpc_scores.push_back(suite.runSteering(scenario, [&steering](double cte, double speed, double delta_t) {
+	    return steering(cte, speed, delta_t);
+	  }));
+      cout << scenario.name << ": PID " << pid_scores.back() << ", MPC " << mpc_scores.back() << endl;
+    }
+    cout << "PID error: " << suite.combine(pid_scores) << endl;
+    cout << "MPC error: " << suite.combine(mpc_scores) << endl;
+    return 0;
+  }
+
+  if ((argc > 1) && (string(argv[1]) == "cascade-offline")) {
+    Gains gains(0.095, 0.053, 0.07);
+    cout << "Comparing cascaded steering with PID [" << gains.p << ", " << gains.i << ", " << gains.d << "]" << endl;
+    std::vector<double> pid_scores, cascade_scores;
+    for (const Scenario& scenario: suite.scenarioList()) {
+      CascadedCarController controller(scenario.speed);
+      pid_scores.push_back(suite.runEpisode(scenario, gains));
+      cascade_scores.push_back(suite.runSteering(scenario, [&controller](double cte, double speed, double delta_t) {
+	    return controller.steer(cte, speed, delta_t);
+	  }));
+      cout << scenario.name << ": PID " << pid_scores.back() << ", cascade " << cascade_scores.back() << endl;
+    }
+    cout << "PID error: " << suite.combine(pid_scores) << endl;
+    cout << "Cascade error: " << suite.combine(cascade_scores) << endl;
+    return 0;
+  }
+
+  // The modes below drive the simulator, which the stability check doesn't
+  // model: it would skip candidates on the strength of the offline plant.
+  if (prefilter) {
+    cerr << "--prefilter only applies to twiddle-offline, bayes-offline and autotune-offline:" << endl
+	 << "the stability check models VehicleModel at 40 mph and a 50 ms period, not the simulator" << endl;
+    return 1;
+  }
 
   if ((argc > 1) && (string(argv[1]) == "twiddle")) {
     cout << "Running twiddle" << endl;
     simulator.onMeasurement(twiddle);
+  } else if ((argc > 1) && (string(argv[1]) == "bayes")) {
+    cout << "Running Bayesian optimization" << endl;
+    simulator.onMeasurement(bayes);
+  } else if ((argc > 1) && (string(argv[1]) == "autotune")) {
+    cout << "Running relay autotune" << endl;
+    simulator.onMeasurement(autotune);
+  } else if ((argc > 1) && (string(argv[1]) == "adaptive")) {
+    cout << "Running production with adaptive gains" << endl;
+    simulator.onMeasurement(adaptive);
+  } else if ((argc > 1) && (string(argv[1]) == "mpc")) {
+    cout << "Running production with MPC steering" << endl;
+    simulator.onMeasurement(mpc);
+  } else if ((argc > 1) && (string(argv[1]) == "cascade")) {
+    cout << "Running production with cascaded control" << endl;
+    simulator.onMeasurement(cascade);
+  } else if ((argc > 1) && (string(argv[1]) == "twiddle-async")) {
+    cout << "Running asynchronous twiddle" << endl;
+    simulator.onMeasurement(async_twiddle);
+    simulator.onSessionClosed(async_twiddle);
   } else {
     cout << "Running production" << endl;
-    simulator.onMeasurement(production);
+    if (steer_rate > 0) {
+      cout << "Steering limited to " << steer_rate << " per second" << endl;
+    }
+    if (profile_speed > 0) {
+      cout << "Speed profile up to " << profile_speed << " mph" << endl;
+    }
+    if (profile_speed > 0 && steer_rate > 0) {
+      simulator.onMeasurement(profiled_slewed_production);
+    } else if (profile_speed > 0) {
+      simulator.onMeasurement(profiled_production);
+    } else if (steer_rate > 0) {
+      simulator.onMeasurement(slewed_production);
+    } else {
+      simulator.onMeasurement(production);
+    }
   }
   
   simulator.run(port);
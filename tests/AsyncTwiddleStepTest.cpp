@@ -0,0 +1,58 @@
+#include "Test.hpp"
+#include "AsyncTwiddler.hpp"
+
+// A probe that finishes before the baseline is judged once the baseline
+// error is known, and the baseline itself doesn't make it stale.
+TEST(AsyncTwiddleStep, EarlyProbeWaitsForBaseline) {
+  AsyncTwiddleStep step(Gains(1, 1, 1), Gains(0.1, 0.2, 0.3));
+  AsyncTwiddleStep::Ticket baseline = step.propose();
+  AsyncTwiddleStep::Ticket up = step.propose();
+  AsyncTwiddleStep::Ticket down = step.propose();
+  step.report(up, 7);
+  CHECK_EQ(step.bestError(), -1.0);
+  CHECK_GAINS(step.incr(), 0.1, 0.2, 0.3);
+  step.report(baseline, 5);
+  CHECK_EQ(step.bestError(), 5.0);
+  CHECK_GAINS(step.bestResult(), 1, 1, 1);
+  CHECK_EQ(step.staleResults(), 0);
+  step.report(down, 6);
+  CHECK_GAINS(step.incr(), 0.09, 0.2, 0.3);
+  CHECK_EQ(step.reportedResults(), 3);
+}
+
+TEST(AsyncTwiddleStep, EarlyImprovement) {
+  AsyncTwiddleStep step(Gains(1, 1, 1), Gains(0.1, 0.2, 0.3));
+  AsyncTwiddleStep::Ticket baseline = step.propose();
+  AsyncTwiddleStep::Ticket up = step.propose();
+  step.report(up, 3);
+  step.report(baseline, 5);
+  CHECK_EQ(step.bestError(), 3.0);
+  CHECK_GAINS(step.bestResult(), 1.1, 1, 1);
+  CHECK_GAINS(step.incr(), 0.11, 0.2, 0.3);
+  CHECK_EQ(step.epoch(), 1);
+}
+
+// Cancelled tickets are proposed again, unless the best gains have moved
+// on since.
+TEST(AsyncTwiddleStep, CancelRequeues) {
+  AsyncTwiddleStep step(Gains(1, 1, 1), Gains(0.1, 0.2, 0.3));
+  AsyncTwiddleStep::Ticket baseline = step.propose();
+  step.cancel(baseline);
+  AsyncTwiddleStep::Ticket again = step.propose();
+  CHECK_EQ(again.gain, -1);
+  AsyncTwiddleStep::Ticket up = step.propose();
+  step.cancel(up);
+  step.report(again, 5);
+  AsyncTwiddleStep::Ticket retry = step.propose();
+  CHECK_EQ(retry.gain, 0);
+  CHECK_EQ(retry.direction, 1);
+  CHECK_GAINS(retry.gains, 1.1, 1, 1);
+
+  AsyncTwiddleStep::Ticket down = step.propose();
+  CHECK_GAINS(down.gains, 0.9, 1, 1);
+  step.cancel(retry);
+  step.report(down, 4);
+  AsyncTwiddleStep::Ticket next = step.propose();
+  CHECK_EQ(next.generation, step.epoch());
+  CHECK_GAINS(next.gains, 0.9, 1.2, 1);
+}
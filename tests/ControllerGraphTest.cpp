@@ -0,0 +1,72 @@
+#include <random>
+#include "ControllerGraph.hpp"
+#include "Test.hpp"
+
+enum { IN, REF, OUT, NEXT };
+
+// The Pid node steps as PidController does, including frames with a
+// delta_t of 0.
+TEST(ControllerGraph, PidMatchesController) {
+  std::mt19937 random(4);
+  std::uniform_real_distribution<double> value(-2, 2), delta(0, 0.1);
+  Gains gains(0.3, 1.2, 0.05);
+  ControllerGraph<Pid<OUT, IN, REF>> graph((Pid<OUT, IN, REF>(gains)));
+  PidController pid(gains, 0.5);
+  graph[REF] = 0.5;
+  for (int step = 0; step < 100; step++) {
+    double measured = value(random), dt = step % 10 == 0 ? 0 : delta(random);
+    graph[IN] = measured;
+    graph(dt);
+    CHECK_NEAR(graph[OUT], pid(measured, dt), 1e-12);
+  }
+}
+
+TEST(ControllerGraph, InverseOrZero) {
+  CHECK_EQ(inverseOrZero(0), 0.0);
+  CHECK_NEAR(inverseOrZero(0.05), 20, 1e-15);
+  CHECK_NEAR(inverseOrZero(-0.3), -1 / 0.3, 1e-15);
+}
+
+// The rate starts from 0, follows a ramp once the filter has settled, and
+// holds on frames with a delta_t of 0.
+TEST(ControllerGraph, Rate) {
+  ControllerGraph<Rate<OUT, IN>> graph((Rate<OUT, IN>(0.05)));
+  graph[IN] = 7;
+  graph(0.05);
+  CHECK_EQ(graph[OUT], 0.0);
+  for (int step = 1; step <= 100; step++) {
+    graph[IN] = 7 + 0.1 * step;
+    graph(0.05);
+  }
+  CHECK_NEAR(graph[OUT], 2, 1e-12);
+  graph[IN] = 100;
+  graph(0);
+  CHECK_NEAR(graph[OUT], 2, 1e-12);
+}
+
+// Nodes run in order, so a node sees the outputs of the ones before it in
+// the same frame, and of the ones after it from the previous frame.
+TEST(ControllerGraph, EvaluationOrder) {
+  ControllerGraph<Feedforward<OUT, NEXT>, Limit<NEXT, IN>, Feedforward<REF, NEXT>>
+    graph(Feedforward<OUT, NEXT>(1), Limit<NEXT, IN>(-1, 1), Feedforward<REF, NEXT>(1));
+  CHECK_EQ(graph.SLOTS, 4);
+  graph[IN] = 5;
+  graph(0.05);
+  CHECK_EQ(graph[OUT], 0.0);
+  CHECK_EQ(graph[REF], 1.0);
+  graph[IN] = -0.5;
+  graph(0.05);
+  CHECK_EQ(graph[OUT], 1.0);
+  CHECK_EQ(graph[REF], 0.5);
+}
+
+TEST(ControllerGraph, SpeedCoupling) {
+  ControllerGraph<SpeedCoupling<OUT, IN, REF>> graph(SpeedCoupling<OUT, IN, REF>(40, 20, 5, 30));
+  graph[IN] = -1;
+  graph[REF] = 0.25;
+  graph(0.05);
+  CHECK_EQ(graph[OUT], 40 - 5 - 7.5);
+  graph[REF] = -1;
+  graph(0.05);
+  CHECK_EQ(graph[OUT], 20.0);
+}
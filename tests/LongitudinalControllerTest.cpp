@@ -0,0 +1,74 @@
+#include "LongitudinalController.hpp"
+#include "Test.hpp"
+
+// On a straight at the target speed, the throttle is the feedforward that
+// holds it.
+TEST(LongitudinalController, HoldsSpeed) {
+  LongitudinalController controller(SpeedProfile(40));
+  for (int step = 0; step < 10; step++) {
+    CHECK_NEAR(controller(40, 0, 0, 0.05), 0.0045 * 40, 1e-12);
+  }
+  CHECK_EQ(controller.targetSpeed(), 40.0);
+}
+
+// A corner that needs a steering command of 0.5 has a radius of about 12 m,
+// where 3 m/s^2 of lateral acceleration allows less than the minimum speed.
+// Once the steering has settled, the target comes down at the profile's
+// rate, and a car still going at the old speed brakes.
+TEST(LongitudinalController, SlowsForCorners) {
+  LongitudinalController controller(SpeedProfile(40));
+  double throttle = 0;
+  for (int step = 0; step < 20; step++) {
+    throttle = controller(40, 0, 0.5, 0.05);
+  }
+  CHECK(controller.targetSpeed() < 40);
+  CHECK(throttle < 0);
+  for (int step = 0; step < 100; step++) {
+    controller(controller.targetSpeed(), 0, 0.5, 0.05);
+  }
+  CHECK_EQ(controller.targetSpeed(), 15.0);
+}
+
+// Once the road straightens, the corner estimate fades and the target goes
+// back up to the maximum.
+TEST(LongitudinalController, RecoversAfterCorners) {
+  LongitudinalController controller(SpeedProfile(40));
+  for (int step = 0; step < 100; step++) {
+    controller(controller.targetSpeed(), 0, 0.5, 0.05);
+  }
+  for (int step = 0; step < 400; step++) {
+    controller(controller.targetSpeed(), 0, 0, 0.05);
+  }
+  CHECK_EQ(controller.targetSpeed(), 40.0);
+}
+
+TEST(LongitudinalController, SlowsOffCenter) {
+  LongitudinalController controller(SpeedProfile(40));
+  for (int step = 0; step < 100; step++) {
+    controller(controller.targetSpeed(), 2, 0, 0.05);
+  }
+  CHECK_NEAR(controller.targetSpeed(), 30, 1e-12);
+}
+
+// Accelerating from 30 mph into a corner that keeps tightening, on a plant
+// that integrates the clamped throttle.
+TEST(LongitudinalController, GoldenTrace) {
+  const double expected[] = {
+    1.1899999999999999,
+    0.38131735862562899,
+    0.32662031293554072,
+    0.27439945520182851,
+    0.22454551223981956,
+    0.17695399813426727,
+    0.13152500495101549,
+    0.088163002592619444,
+  };
+  LongitudinalController controller(SpeedProfile(40));
+  double speed = 30;
+  for (int k = 0; k < 8; k++) {
+    double throttle = controller(speed, 0.2 * k, 0.05 * k, 0.05);
+    CHECK_GOLDEN(throttle, expected[k]);
+    speed += fmin(fmax(throttle, -1.0), 1.0) * 5 / 0.44704 * 0.05;
+  }
+  CHECK_GOLDEN(controller.targetSpeed(), 37.20000000000001);
+}
@@ -0,0 +1,44 @@
+#include "OutputShaping.hpp"
+#include "Test.hpp"
+
+TEST(OutputShaping, Clamp) {
+  Clamp clamp;
+  CHECK_EQ(clamp(1.5, 0.05), 1.0);
+  CHECK_EQ(clamp(-3, 0.05), -1.0);
+  CHECK_EQ(clamp(0.25, 0.05), 0.25);
+  CHECK_EQ(Clamp(0, 0.5)(-0.1, 0.05), 0.0);
+}
+
+// The output moves at most max_rate * delta_t per call, from 'initial', and
+// holds when delta_t is 0.
+TEST(OutputShaping, SlewRate) {
+  SlewRate slew(4, 0.5);
+  CHECK_EQ(slew(1, 0), 0.5);
+  CHECK_NEAR(slew(1, 0.05), 0.7, 1e-15);
+  CHECK_NEAR(slew(-1, 0.1), 0.3, 1e-15);
+  CHECK_NEAR(slew(0.25, 0.1), 0.25, 1e-15);
+  slew.reset();
+  CHECK_NEAR(slew(1, 0.05), 0.2, 1e-15);
+}
+
+TEST(OutputShaping, Deadband) {
+  Deadband deadband(0.01);
+  CHECK_EQ(deadband(0.005, 0.05), 0.0);
+  CHECK_EQ(deadband(-0.005, 0.05), 0.0);
+  CHECK_EQ(deadband(0.02, 0.05), 0.02);
+}
+
+// Stages run in the order they are listed, and no stages pass values
+// through.
+TEST(OutputShaping, Pipeline) {
+  OutputShaper<> identity;
+  CHECK_EQ(identity(7.5, 0.05), 7.5);
+
+  OutputShaper<Deadband, Clamp, SlewRate> shaper(Deadband(0.05), Clamp(), SlewRate(10));
+  CHECK_NEAR(shaper(3, 0.05), 0.5, 1e-15);
+  CHECK_NEAR(shaper(3, 0.05), 1, 1e-15);
+  CHECK_NEAR(shaper(0.01, 0.05), 0.5, 1e-15);
+  CHECK_NEAR(shaper(0.01, 0.1), 0, 1e-15);
+  shaper.stage<SlewRate>().reset(1);
+  CHECK_EQ(shaper(1, 0.05), 1.0);
+}
@@ -0,0 +1,102 @@
+#include <random>
+#include "PidController.hpp"
+#include "Test.hpp"
+
+// The steering gains of the production controller.
+static const Gains PRODUCTION(0.31, 1.1, 0.01);
+
+TEST(PidController, FirstStepWithoutTime) {
+  PidController pid(Gains(2, 3, 5), 1);
+  // With delta_t == 0 there is neither a derivative nor any integration.
+  CHECK_EQ(pid(0.25, 0), 2 * 0.75);
+  CHECK_EQ(pid(0.5, 0), 2 * 0.5);
+  CHECK_EQ(pid.squaredSumError(), 0.75 * 0.75 + 0.5 * 0.5);
+}
+
+TEST(PidController, ZeroDeltaKeepsIntegral) {
+  PidController pid(Gains(0, 1, 0), 0);
+  pid(-2, 0.5);
+  CHECK_EQ(pid(-2, 0), 1.0);
+  CHECK_EQ(pid(7, 0), 1.0);
+  CHECK_EQ(pid(-2, 0.5), 2.0);
+}
+
+TEST(PidController, IntegralAccumulates) {
+  PidController pid(Gains(0, 2, 0), 0);
+  double errors[] = { 1, -0.5, 0.25, 2, -3 };
+  double deltas[] = { 0.1, 0.05, 0.2, 0.1, 0.05 };
+  double integral = 0;
+  for (int k = 0; k < 5; k++) {
+    integral += errors[k] * deltas[k];
+    CHECK_NEAR(pid(-errors[k], deltas[k]), 2 * integral, 1e-15);
+  }
+}
+
+TEST(PidController, DerivativeOfError) {
+  PidController pid(Gains(0, 0, 1), 0);
+  // The derivative starts from a previous error of zero.
+  CHECK_NEAR(pid(-1, 0.5), 2, 1e-15);
+  CHECK_NEAR(pid(-1, 0.5), 0, 1e-15);
+  CHECK_NEAR(pid(0.5, 0.25), -6, 1e-15);
+}
+
+TEST(PidController, GoldenTrace) {
+  const double expected[] = {
+    -0.096575748892545346,
+    -0.25712945986205227,
+    -0.35486563341359706,
+    -0.4392632438093137,
+    -0.50490482063637188,
+    -0.54829396341025916,
+    -0.56816766461690338,
+    -0.56560913041235072,
+  };
+  PidController pid(PRODUCTION, 0);
+  for (int k = 0; k < 8; k++) {
+    double cte = 0.8 * sin(0.3 * k + 0.4) + 0.05 * k;
+    CHECK_GOLDEN(pid(cte, k == 0 ? 0 : 0.05), expected[k]);
+  }
+  CHECK_GOLDEN(pid.squaredSumError(), 5.4592073707940472);
+}
+
+// The output is linear in the gains, for any history of measurements.
+TEST(PidController, LinearInGains) {
+  std::mt19937 random(1);
+  std::uniform_real_distribution<double> value(-2, 2), delta(0, 0.1);
+  for (int trial = 0; trial < 100; trial++) {
+    Gains a(value(random), value(random), value(random));
+    Gains b(value(random), value(random), value(random));
+    double set_point = value(random);
+    PidController pa(a, set_point), pb(b, set_point), sum(Gains(a.p + b.p, a.i + b.i, a.d + b.d), set_point);
+    for (int step = 0; step < 20; step++) {
+      double measured = value(random), dt = step == 0 ? 0 : delta(random);
+      double expected = pa(measured, dt) + pb(measured, dt);
+      CHECK_NEAR(sum(measured, dt), expected, 1e-9);
+    }
+  }
+}
+
+// Every lane of a PidBank follows the scalar controller with its gains.
+TEST(PidController, BankMatchesScalar) {
+  std::mt19937 random(2);
+  std::uniform_real_distribution<double> value(-2, 2), delta(0.01, 0.1);
+  const int W = 4;
+  PidBank<W> bank(0.5);
+  PidController scalar[W];
+  for (int lane = 0; lane < W; lane++) {
+    Gains gains(value(random), value(random), value(random));
+    bank.setGains(lane, gains);
+    scalar[lane] = PidController(gains, 0.5);
+  }
+  for (int step = 0; step < 50; step++) {
+    double measured[W], out[W];
+    double dt = step == 0 ? 0 : delta(random);
+    for (int lane = 0; lane < W; lane++) {
+      measured[lane] = value(random);
+    }
+    bank(measured, dt, out);
+    for (int lane = 0; lane < W; lane++) {
+      CHECK_NEAR(out[lane], scalar[lane](measured[lane], dt), 1e-12);
+    }
+  }
+}
@@ -0,0 +1,174 @@
+#include <random>
+#include <string.h>
+#include "Protocol.hpp"
+#include "Test.hpp"
+
+static const char TELEMETRY[] =
+  "42[\"telemetry\",{\"cte\":\"0.7598\",\"speed\":\"30.12\",\"steering_angle\":\"-2.5\",\"throttle\":\"0.3\","
+  "\"image\":\"\"}]";
+
+TEST(Protocol, GetDataFindsArray) {
+  std::string_view data = TextProtocol::getData("42[\"steer\",{\"a\":[1,2]}]");
+  CHECK_EQ(data, "[\"steer\",{\"a\":[1,2]}]");
+  CHECK_EQ(TextProtocol::getData("42[\"x\"] trailing"), "[\"x\"]");
+}
+
+TEST(Protocol, GetDataRejects) {
+  // The simulator sends null when the car is driven manually.
+  CHECK(TextProtocol::getData("42[\"telemetry\",null]").empty());
+  CHECK(TextProtocol::getData("42").empty());
+  CHECK(TextProtocol::getData("42[\"telemetry\"").empty());
+  CHECK(TextProtocol::getData("").empty());
+}
+
+TEST(Protocol, FindNumber) {
+  double value = 0;
+  CHECK(TextProtocol::findNumber("{\"cte\":\"-1.25\"}", "cte", value));
+  CHECK_EQ(value, -1.25);
+  CHECK(TextProtocol::findNumber("{\"time\":12.5,\"x\":1}", "time", value));
+  CHECK_EQ(value, 12.5);
+  // Only whole keys count: "steering_angle" isn't "angle".
+  CHECK(!TextProtocol::findNumber("{\"steering_angle\":1}", "angle", value));
+  CHECK(!TextProtocol::findNumber("{\"cte\":\"abc\"}", "cte", value));
+  CHECK(!TextProtocol::findNumber("{\"cte\":", "cte", value));
+}
+
+TEST(Protocol, TelemetryFastPath) {
+  Measurement m;
+  m.time = 0;
+  std::string_view payload = TextProtocol::getData(TELEMETRY);
+  CHECK(TextProtocol::parseTelemetry(payload, m) == ParseStatus::OK);
+  CHECK_EQ(m.cte, 0.7598);
+  CHECK_EQ(m.speed, 30.12);
+  CHECK_EQ(m.angle, -2.5);
+  CHECK_EQ(m.time, -1.0);
+}
+
+// Keys only count as members of the telemetry object, not inside a string
+// or a nested object.
+TEST(Protocol, TelemetryFastPathKeys) {
+  Measurement m;
+  CHECK(TextProtocol::parseTelemetry("[\"telemetry\",{\"image\":\"x\\\"cte\\\":\\\"9\\\"\",\"cte\":\"0.5\","
+				     "\"speed\":\"1\",\"steering_angle\":\"0\"}]", m) == ParseStatus::OK);
+  CHECK_EQ(m.cte, 0.5);
+  CHECK(TextProtocol::parseTelemetry("[\"telemetry\",{\"meta\":{\"cte\":[\"9\"]},\"cte\":\"0.25\",\"speed\":\"1\","
+				     "\"steering_angle\":\"0\"}]", m) == ParseStatus::OK);
+  CHECK_EQ(m.cte, 0.25);
+}
+
+// Whitespace between tokens is allowed, and other events are told apart from
+// frames that are broken.
+TEST(Protocol, TelemetryStatus) {
+  Measurement m;
+  CHECK(TextProtocol::parseTelemetry("[ \"telemetry\", {\"speed\": \"30.12\", \"cte\": \"0.7598\", "
+				     "\"steering_angle\": \"-2.5\", \"time\": 3.25} ]", m) == ParseStatus::OK);
+  CHECK_EQ(m.cte, 0.7598);
+  CHECK_EQ(m.speed, 30.12);
+  CHECK_EQ(m.angle, -2.5);
+  CHECK_EQ(m.time, 3.25);
+  CHECK(TextProtocol::parseTelemetry("[\"other\",{}]", m) == ParseStatus::OTHER_EVENT);
+  const char* malformed[] = {
+    "[\"telemetry\",{\"cte\":\"0.5\",\"speed\":\"1\",\"steering_angle\":\"0\",\"cte\":\"0.25\"}]",
+    "[\"telemetry\",{\"cte\":\"0.5x\",\"speed\":\"1\",\"steering_angle\":\"0\"}]",
+    "[\"telemetry\",{\"cte\":\"0.5\",\"speed\":\"1\",\"steering_angle\":\"0\"",
+    "[\"telemetry\",{\"cte\":\"0.5\",\"speed\":\"1\"}]",
+    "[\"telemetry\",{\"cte\":{\"x\":1},\"speed\":\"1\",\"steering_angle\":\"0\"}]",
+    "[\"telemetry\",{\"cte\":\"nan\",\"speed\":\"1\",\"steering_angle\":\"0\"}]",
+    "[\"telemetry\",{\"cte\":\"0.5\",\"speed\":\"1e999\",\"steering_angle\":\"0\"}]",
+    "[\"telemetry\",7]",
+    "[\"telem",
+  };
+  for (const char* frame: malformed) {
+    CHECK(TextProtocol::parseTelemetry(frame, m) == ParseStatus::MALFORMED);
+  }
+}
+
+TEST(Protocol, ControlGolden) {
+  char out[TextProtocol::MAX_CONTROL_SIZE];
+  size_t length = TextProtocol::control(-0.123456789, 0.3, out);
+  CHECK_EQ(std::string(out, length), "42[\"steer\",{\"steering_angle\":-0.123456789,\"throttle\":0.3}]");
+  length = TextProtocol::control(0.1, NAN, out);
+  CHECK_EQ(std::string(out, length), "42[\"steer\",{\"steering_angle\":0.1,\"throttle\":null}]");
+}
+
+// Commands read back exactly.
+TEST(Protocol, ControlRoundTrip) {
+  std::mt19937 random(3);
+  std::uniform_real_distribution<double> value(-1, 1);
+  char out[TextProtocol::MAX_CONTROL_SIZE];
+  for (int trial = 0; trial < 1000; trial++) {
+    double steer = value(random), throttle = value(random) * 1e-7;
+    std::string_view text(out, TextProtocol::control(steer, throttle, out));
+    double steer_back, throttle_back;
+    CHECK(TextProtocol::findNumber(text, "steering_angle", steer_back));
+    CHECK(TextProtocol::findNumber(text, "throttle", throttle_back));
+    CHECK_EQ(steer_back, steer);
+    CHECK_EQ(throttle_back, throttle);
+  }
+}
+
+TEST(Protocol, BinaryRoundTrip) {
+  BinaryFrame frame(BinaryFrame::TELEMETRY);
+  frame.flags = BinaryFrame::LOCKSTEP;
+  frame.cte = -0.5;
+  frame.speed = 31.25;
+  frame.angle = 1e-300;
+  frame.time = 12.05;
+  char out[BinaryProtocol::FRAME_SIZE];
+  BinaryProtocol::encode(frame, out);
+  CHECK_EQ((int)out[0], 1);
+  CHECK_EQ((int)(uint8_t)out[BinaryProtocol::HEADER_SIZE + 7], 0xbf);
+
+  BinaryFrame back;
+  CHECK(BinaryProtocol::decode(out, sizeof(out), back));
+  CHECK(!BinaryProtocol::decode(out, sizeof(out) - 1, back));
+  std::string_view payload;
+  Measurement m;
+  CHECK(classifyFrame(out, sizeof(out), Protocol::BINARY, payload, back) == FrameKind::EVENT);
+  CHECK(parseMeasurement(payload, back, Protocol::BINARY, m) == ParseStatus::OK);
+  CHECK_EQ(m.cte, -0.5);
+  CHECK_EQ(m.speed, 31.25);
+  CHECK_EQ(m.angle, 1e-300);
+  CHECK_EQ(m.time, 12.05);
+}
+
+TEST(Protocol, ClassifyText) {
+  std::string_view payload;
+  BinaryFrame frame;
+  CHECK(classifyFrame(TELEMETRY, strlen(TELEMETRY), Protocol::TEXT, payload, frame) == FrameKind::EVENT);
+  CHECK_EQ(payload.front(), '[');
+  CHECK(classifyFrame("42[\"telemetry\",null]", 20, Protocol::TEXT, payload, frame) == FrameKind::MANUAL);
+  CHECK(classifyFrame("40", 2, Protocol::TEXT, payload, frame) == FrameKind::IGNORED);
+  CHECK(classifyFrame("2", 1, Protocol::TEXT, payload, frame) == FrameKind::IGNORED);
+}
+
+// Only telemetry counts as a skipped frame when coalescing.
+TEST(Protocol, IsTelemetryFrame) {
+  CHECK(isTelemetryFrame(TELEMETRY, strlen(TELEMETRY), Protocol::TEXT));
+  CHECK(!isTelemetryFrame("42[\"telemetry\",null]", 20, Protocol::TEXT));
+  CHECK(!isTelemetryFrame("42[\"steer\",{}]", 15, Protocol::TEXT));
+  CHECK(!isTelemetryFrame("42[\"telemetryx\",{}]", 20, Protocol::TEXT));
+  CHECK(!isTelemetryFrame("40", 2, Protocol::TEXT));
+
+  char out[BinaryProtocol::FRAME_SIZE];
+  BinaryProtocol::encode(BinaryFrame(BinaryFrame::TELEMETRY), out);
+  CHECK(isTelemetryFrame(out, sizeof(out), Protocol::BINARY));
+  BinaryProtocol::encode(BinaryFrame(BinaryFrame::STEER), out);
+  CHECK(!isTelemetryFrame(out, sizeof(out), Protocol::BINARY));
+  CHECK(!isTelemetryFrame(out, sizeof(out) - 1, Protocol::BINARY));
+}
+
+// Binary frames that don't decode, and binary telemetry with a non-finite
+// value, are counted as malformed rather than dropped silently.
+TEST(Protocol, BinaryMalformed) {
+  char out[BinaryProtocol::FRAME_SIZE];
+  BinaryFrame frame(BinaryFrame::TELEMETRY);
+  frame.cte = NAN;
+  BinaryProtocol::encode(frame, out);
+  std::string_view payload;
+  BinaryFrame back;
+  Measurement m;
+  CHECK(classifyFrame(out, sizeof(out) - 1, Protocol::BINARY, payload, back) == FrameKind::MALFORMED);
+  CHECK(classifyFrame(out, sizeof(out), Protocol::BINARY, payload, back) == FrameKind::EVENT);
+  CHECK(parseMeasurement(payload, back, Protocol::BINARY, m) == ParseStatus::MALFORMED);
+}
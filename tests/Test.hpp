@@ -0,0 +1,94 @@
+#ifndef __TEST_H
+#define __TEST_H
+
+#include <iostream>
+#include <math.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// A minimal test registry: TEST(Suite, name) defines a test case, and the
+// CHECK macros record failures without stopping the test, so that one run
+// reports every number that moved. Golden numbers are compared with a
+// relative tolerance that allows for a different last bit of rounding
+// (from FMA contraction, say) but not for a change in behavior.
+struct TestCase {
+  std::string name;
+  void (*run)();
+};
+
+inline std::vector<TestCase>& testCases() {
+  static std::vector<TestCase> cases;
+  return cases;
+}
+
+inline int& testFailures() {
+  static int failures = 0;
+  return failures;
+}
+
+struct TestRegistration {
+  TestRegistration(const char* name, void (*run)()) { testCases().push_back({ name, run }); }
+};
+
+#define TEST(suite, name)						\
+  static void suite##_##name();						\
+  static TestRegistration suite##_##name##_registration(#suite "." #name, suite##_##name); \
+  static void suite##_##name()
+
+inline void testFailed(const char* file, int line, const std::string& message) {
+  std::cout << file << ":" << line << ": " << message << std::endl;
+  testFailures()++;
+}
+
+inline bool testNear(double actual, double expected, double tolerance) {
+  if (actual == expected) {
+    return true;
+  }
+  return fabs(actual - expected) <= tolerance * fmax(1.0, fmax(fabs(actual), fabs(expected)));
+}
+
+const double GOLDEN_TOLERANCE = 1e-12;
+
+#define CHECK(condition)						\
+  do {									\
+    if (!(condition)) {							\
+      testFailed(__FILE__, __LINE__, "CHECK(" #condition ") failed");	\
+    }									\
+  } while (0)
+
+#define CHECK_EQ(actual, expected)					\
+  do {									\
+    auto actual_value = (actual);					\
+    auto expected_value = (expected);					\
+    if (!(actual_value == expected_value)) {				\
+      std::ostringstream message;					\
+      message << #actual " is " << actual_value << ", expected " << expected_value; \
+      testFailed(__FILE__, __LINE__, message.str());			\
+    }									\
+  } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)				\
+  do {									\
+    double actual_value = (actual);					\
+    double expected_value = (expected);					\
+    if (!testNear(actual_value, expected_value, (tolerance))) {		\
+      std::ostringstream message;					\
+      message.precision(17);						\
+      message << #actual " is " << actual_value << ", expected " << expected_value; \
+      testFailed(__FILE__, __LINE__, message.str());			\
+    }									\
+  } while (0)
+
+#define CHECK_GOLDEN(actual, expected) CHECK_NEAR(actual, expected, GOLDEN_TOLERANCE)
+
+// Compares the three terms of a set of PID gains, to within rounding.
+#define CHECK_GAINS(actual, expected_p, expected_i, expected_d)		\
+  do {									\
+    auto gains_value = (actual);					\
+    CHECK_NEAR(gains_value.p, expected_p, 1e-15);			\
+    CHECK_NEAR(gains_value.i, expected_i, 1e-15);			\
+    CHECK_NEAR(gains_value.d, expected_d, 1e-15);			\
+  } while (0)
+
+#endif
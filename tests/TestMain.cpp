@@ -0,0 +1,23 @@
+#include <string.h>
+#include "Test.hpp"
+
+// Runs the tests whose names start with the first argument, or all of them.
+int main(int argc, char* argv[]) {
+  const char* prefix = argc > 1 ? argv[1] : "";
+  int run = 0;
+  for (const TestCase& test: testCases()) {
+    if (test.name.compare(0, strlen(prefix), prefix) != 0) {
+      continue;
+    }
+    int failures = testFailures();
+    test.run();
+    std::cout << (testFailures() == failures ? "PASS " : "FAIL ") << test.name << std::endl;
+    run++;
+  }
+  if (run == 0) {
+    std::cout << "No tests match '" << prefix << "'" << std::endl;
+    return 1;
+  }
+  std::cout << run << " tests, " << testFailures() << " failures" << std::endl;
+  return testFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include "Test.hpp"
+#include "Twiddler.hpp"
+
+// Each gain is tried at +increment, then at -increment, then restored with
+// a smaller increment before moving on to the next gain.
+TEST(TwiddleStep, ThreePhaseCycle) {
+  TwiddleStep step(Gains(1, 1, 1), Gains(0.1, 0.2, 0.3));
+  step.next(5);
+  CHECK_EQ(step.bestError(), 5.0);
+  CHECK_GAINS(step.current(), 1.1, 1, 1);
+  step.next(6);
+  CHECK_GAINS(step.current(), 0.9, 1, 1);
+  step.next(7);
+  CHECK_GAINS(step.current(), 1, 1.2, 1);
+  CHECK_GAINS(step.incr(), 0.09, 0.2, 0.3);
+  CHECK_GAINS(step.bestResult(), 1, 1, 1);
+  CHECK_EQ(step.bestError(), 5.0);
+  CHECK_EQ(step.epoch(), 0);
+}
+
+// An improvement keeps the gains, grows the increment and moves on, and
+// wrapping around to the first gain starts a new epoch.
+TEST(TwiddleStep, ImprovementMovesOn) {
+  TwiddleStep step(Gains(1, 1, 1), Gains(0.1, 0.2, 0.3));
+  step.next(5);
+  step.next(6);
+  step.next(7);
+  step.next(4);
+  CHECK_GAINS(step.bestResult(), 1, 1.2, 1);
+  CHECK_GAINS(step.incr(), 0.09, 0.22, 0.3);
+  CHECK_GAINS(step.current(), 1, 1.2, 1.3);
+  CHECK_EQ(step.epoch(), 0);
+  step.next(3);
+  CHECK_GAINS(step.bestResult(), 1, 1.2, 1.3);
+  CHECK_GAINS(step.current(), 1.09, 1.2, 1.3);
+  CHECK_EQ(step.epoch(), 1);
+}
+
+TEST(TwiddleStep, ImprovementOnNegativeProbe) {
+  TwiddleStep step(Gains(1, 1, 1), Gains(0.1, 0.2, 0.3));
+  step.next(5);
+  step.next(6);
+  step.next(4);
+  CHECK_GAINS(step.bestResult(), 0.9, 1, 1);
+  CHECK_GAINS(step.incr(), 0.11, 0.2, 0.3);
+  CHECK_GAINS(step.current(), 0.9, 1.2, 1);
+}
+
+// A rejected candidate moves the search on as a probe that doesn't improve,
+// without touching the best error.
+TEST(TwiddleStep, RejectIsNotAnObservation) {
+  TwiddleStep step(Gains(1, 1, 1), Gains(0.1, 0.2, 0.3));
+  step.next(5);
+  step.reject();
+  CHECK_GAINS(step.current(), 0.9, 1, 1);
+  step.reject();
+  CHECK_GAINS(step.current(), 1, 1.2, 1);
+  CHECK_GAINS(step.incr(), 0.09, 0.2, 0.3);
+  CHECK_GAINS(step.bestResult(), 1, 1, 1);
+  CHECK_EQ(step.bestError(), 5.0);
+}
+
+TEST(TwiddleStep, SkipsZeroIncrements) {
+  TwiddleStep step(Gains(1, 1, 1), Gains(0.1, 0, 0.3));
+  step.next(5);
+  step.next(4);
+  CHECK_GAINS(step.current(), 1.1, 1, 1.3);
+  CHECK_EQ(step.epoch(), 0);
+  step.next(3);
+  CHECK_GAINS(step.current(), 1.21, 1, 1.3);
+  CHECK_EQ(step.epoch(), 1);
+  // A failed cycle also skips the gain without increment.
+  step.next(8);
+  step.next(9);
+  CHECK_GAINS(step.current(), 1.1, 1, 1.3 + 0.33);
+  CHECK_GAINS(step.incr(), 0.099, 0, 0.33);
+}
+
+TEST(TwiddleStep, FinishesOnSmallIncrements) {
+  CHECK(TwiddleStep(Gains(1, 1, 1), Gains(0.004, 0.003, 0.002)).hasFinished());
+  CHECK(!TwiddleStep(Gains(1, 1, 1), Gains(0.005, 0.003, 0.003)).hasFinished());
+  CHECK(!TwiddleStep(Gains(1, 1, 1), Gains(0.1, 0, 0)).hasFinished());
+}
+
+static double bowl(const Gains& g) {
+  return (g.p - 0.2) * (g.p - 0.2) + 10 * (g.i - 0.01) * (g.i - 0.01) + (g.d - 3) * (g.d - 3);
+}
+
+// The first 300 steps of a search on a quadratic bowl. Its comparisons are
+// all decided by more than 1e-6 relative, so rounding differences (FMA
+// contraction with -march=native, say) can't change the path; towards the
+// end of a search they can.
+TEST(TwiddleStep, GoldenSearch) {
+  TwiddleStep step(Gains(0, 0, 0), Gains(0.1, 0.01, 1));
+  for (int evaluation = 0; evaluation < 300; evaluation++) {
+    step.next(bowl(step.current()));
+  }
+  CHECK(!step.hasFinished());
+  CHECK_EQ(step.epoch(), 53);
+  CHECK_GOLDEN(step.bestResult().p, 0.19304643278320138);
+  CHECK_GOLDEN(step.bestResult().i, 0.010000000000000002);
+  CHECK_GOLDEN(step.bestResult().d, 3.1152115722657285);
+  CHECK_GOLDEN(step.bestError(), 0.013322058480979726);
+}
+
+TEST(TwiddleStep, SearchConverges) {
+  TwiddleStep step(Gains(0, 0, 0), Gains(0.1, 0.01, 1));
+  int evaluations = 0;
+  while (!step.hasFinished() && evaluations < 10000) {
+    step.next(bowl(step.current()));
+    evaluations++;
+  }
+  CHECK(step.hasFinished());
+  CHECK(step.bestError() < 1e-4);
+  CHECK_NEAR(step.bestResult().p, 0.2, 0.01);
+  CHECK_NEAR(step.bestResult().d, 3, 0.01);
+}
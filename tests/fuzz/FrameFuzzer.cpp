@@ -0,0 +1,101 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "Protocol.hpp"
+#include "TelemetryReplay.hpp"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// Takes one line of a telemetry recording (a text frame, or 'b' and the hex
+// bytes of a binary frame) through the path of a frame from the socket to a
+// Measurement. Besides crashes, sanitizer reports and exceptions, it flags
+// a text frame whose fields the parser reads differently from the JSON
+// library, and a measurement accepted with a value that isn't finite.
+
+static void check(bool condition, const char* message) {
+  if (!condition) {
+    fprintf(stderr, "%s\n", message);
+    abort();
+  }
+}
+
+static bool sameNumber(double a, double b) {
+  return a == b || (isnan(a) && isnan(b));
+}
+
+// Reads a field as a number, quoted or not.
+static bool referenceNumber(const json& object, const char* key, double& value) {
+  auto field = object.find(key);
+  if (field == object.end()) {
+    return false;
+  }
+  if (field->is_number()) {
+    value = field->get<double>();
+    return true;
+  }
+  if (!field->is_string()) {
+    return false;
+  }
+  std::string text = field->get<std::string>();
+  char* end;
+  value = strtod(text.c_str(), &end);
+  return end != text.c_str();
+}
+
+static bool referenceTelemetry(std::string_view payload, Measurement& m) {
+  try {
+    json j = json::parse(payload.begin(), payload.end());
+    if (!j.is_array() || j.size() < 2 || !j[0].is_string() || j[0].get<std::string>() != "telemetry" ||
+	!j[1].is_object()) {
+      return false;
+    }
+    if (!referenceNumber(j[1], "cte", m.cte) || !referenceNumber(j[1], "speed", m.speed) ||
+	!referenceNumber(j[1], "steering_angle", m.angle)) {
+      return false;
+    }
+    if (!referenceNumber(j[1], "time", m.time)) {
+      m.time = -1;
+    }
+    return true;
+  } catch (const std::exception&) {
+    return false;
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  std::string_view line((const char*)data, size);
+  if (!line.empty() && line.back() == '\n') {
+    line.remove_suffix(1);
+  }
+  std::string frame;
+  Protocol protocol;
+  if (!TelemetryReplay::decodeLine(line, frame, protocol)) {
+    return 0;
+  }
+
+  std::string_view payload;
+  BinaryFrame binary;
+  if (classifyFrame(frame.data(), frame.size(), protocol, payload, binary) != FrameKind::EVENT) {
+    return 0;
+  }
+  if (protocol == Protocol::TEXT) {
+    check(payload.data() >= frame.data() && payload.data() + payload.size() <= frame.data() + frame.size(),
+	  "payload outside the frame");
+    Measurement fast, reference;
+    if (TextProtocol::parseTelemetry(payload, fast) == ParseStatus::OK && referenceTelemetry(payload, reference)) {
+      check(sameNumber(fast.cte, reference.cte), "cte differs from the JSON parser");
+      check(sameNumber(fast.speed, reference.speed), "speed differs from the JSON parser");
+      check(sameNumber(fast.angle, reference.angle), "steering_angle differs from the JSON parser");
+      check(sameNumber(fast.time, reference.time), "time differs from the JSON parser");
+    }
+  }
+
+  Measurement m;
+  if (parseMeasurement(payload, binary, protocol, m) == ParseStatus::OK) {
+    check(isfinite(m.cte) && isfinite(m.speed) && isfinite(m.angle), "measurement with a value that isn't finite");
+  }
+  return 0;
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Stands in for libFuzzer where it isn't available, with the same command
+// line: frame_fuzzer [-runs=N] [-seed=S] <file or directory>... runs every
+// input once, then N random mutations of them (none by default). An input
+// that crashes is written to crash-input before the process dies.
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static const std::string* current_input = nullptr;
+
+static void saveCurrentInput(int signal_number) {
+  if (current_input) {
+    int fd = open("crash-input", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+      ssize_t written = write(fd, current_input->data(), current_input->size());
+      (void)written;
+      close(fd);
+    }
+    const char message[] = "Crashing input written to crash-input\n";
+    ssize_t written = write(2, message, sizeof(message) - 1);
+    (void)written;
+  }
+  signal(signal_number, SIG_DFL);
+  raise(signal_number);
+}
+
+static void run(const std::string& input) {
+  current_input = &input;
+  LLVMFuzzerTestOneInput((const uint8_t*)input.data(), input.size());
+  current_input = nullptr;
+}
+
+static bool readFile(const std::string& path, std::string& contents) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  return true;
+}
+
+static void collect(const std::string& path, std::vector<std::string>& inputs) {
+  DIR* dir = opendir(path.c_str());
+  if (!dir) {
+    std::string contents;
+    if (readFile(path, contents)) {
+      inputs.push_back(contents);
+    } else {
+      std::cerr << "Could not read " << path << std::endl;
+    }
+    return;
+  }
+  std::vector<std::string> names;
+  while (dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+  for (const std::string& name: names) {
+    collect(path + "/" + name, inputs);
+  }
+}
+
+// Byte flips, insertions and deletions, and splices of another input; the
+// inserted bytes favor the characters the frame syntax is made of.
+static std::string mutate(const std::vector<std::string>& inputs, std::mt19937& random) {
+  static const char syntax[] = "0123456789.-+eE\"\\{}[],: naftrulx";
+  std::string input = inputs[random() % inputs.size()];
+  int count = 1 + random() % 4;
+  for (int k = 0; k < count; k++) {
+    size_t pos = input.empty() ? 0 : random() % (input.size() + 1);
+    switch (random() % 5) {
+    case 0:
+      if (pos < input.size()) input[pos] ^= (char)(1 << (random() % 8));
+      break;
+    case 1:
+      input.insert(pos, 1, syntax[random() % (sizeof(syntax) - 1)]);
+      break;
+    case 2:
+      if (pos < input.size()) input.erase(pos, 1 + random() % 8);
+      break;
+    case 3: {
+      const std::string& other = inputs[random() % inputs.size()];
+      size_t start = other.empty() ? 0 : random() % other.size();
+      input.insert(pos, other.substr(start, 1 + random() % 16));
+      break;
+    }
+    default:
+      input.resize(pos);
+    }
+  }
+  return input;
+}
+
+int main(int argc, char* argv[]) {
+  long runs = 0;
+  unsigned seed = 1;
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 6, "-runs=") == 0) {
+      runs = atol(arg.c_str() + 6);
+    } else if (arg.compare(0, 6, "-seed=") == 0) {
+      seed = (unsigned)atol(arg.c_str() + 6);
+    } else if (arg[0] == '-') {
+      std::cerr << "Ignoring " << arg << std::endl;
+    } else {
+      collect(arg, inputs);
+    }
+  }
+  if (inputs.empty()) {
+    std::cerr << "No inputs" << std::endl;
+    return 1;
+  }
+
+  signal(SIGABRT, saveCurrentInput);
+  signal(SIGSEGV, saveCurrentInput);
+  for (const std::string& input: inputs) {
+    run(input);
+  }
+  std::mt19937 random(seed);
+  for (long k = 0; k < runs; k++) {
+    run(mutate(inputs, random));
+  }
+  std::cout << "Ran " << inputs.size() << " inputs and " << runs << " mutations" << std::endl;
+  return 0;
+}